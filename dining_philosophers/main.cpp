@@ -1,11 +1,23 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <concepts>
 #include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <queue>
 #include <random>
-#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 // 日志级别枚举
@@ -16,80 +28,303 @@ enum class LogLevel : std::uint8_t {
     ERROR
 };
 
+// 编译期检查的格式串：构造时统计 "{}" 占位符，个数与参数不符时编译失败
+template <typename... Args>
+class FormatString {
+private:
+    std::string_view text;
+
+public:
+    template <typename S>
+        requires std::convertible_to<const S&, std::string_view>
+    consteval FormatString(const S& format) // NOLINT(google-explicit-constructor)
+        : text(format) {
+        size_t placeholders = 0;
+        for (size_t pos = text.find("{}"); pos != std::string_view::npos; pos = text.find("{}", pos + 2)) {
+            ++placeholders;
+        }
+        if (placeholders != sizeof...(Args)) {
+            throw "format string placeholder count does not match the number of arguments";
+        }
+    }
+
+    [[nodiscard]] constexpr auto get() const -> std::string_view { return text; }
+};
+
+// 异步日志缓冲区写满时的处理方式
+enum class LogOverflow : std::uint8_t {
+    DROP,  // 丢弃新记录并计数
+    BLOCK // 等待后台线程腾出空间
+};
+
+// 一条待输出的日志，定长以免写日志时分配内存，过长的消息会被截断
+struct LogRecord {
+    static constexpr size_t MAX_MESSAGE = 200;
+
+    std::chrono::steady_clock::time_point time;
+    LogLevel level;
+    std::uint16_t length;
+    char text[MAX_MESSAGE];
+};
+
+// 单生产者单消费者的无锁环形缓冲区：生产者是写日志的线程，消费者是后台输出线程
+class LogRing {
+private:
+    std::unique_ptr<LogRecord[]> records;
+    size_t mask;
+    // 生产者与消费者的下标放在不同缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    alignas(64) std::atomic<size_t> head{ 0 };
+    std::atomic<std::uint64_t> dropped{ 0 };
+
+public:
+    // capacity 向上取整为 2 的幂
+    explicit LogRing(size_t capacity)
+        : records(std::make_unique<LogRecord[]>(std::bit_ceil(capacity))),
+          mask(std::bit_ceil(capacity) - 1) {}
+
+    // 只能由生产者调用
+    void push(LogLevel level, std::string_view message, LogOverflow overflow) {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        while (position - head.load(std::memory_order_acquire) > mask) {
+            if (overflow == LogOverflow::DROP) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+        LogRecord& record = records[position & mask];
+        record.time = std::chrono::steady_clock::now();
+        record.level = level;
+        record.length = static_cast<std::uint16_t>(std::min(message.size(), LogRecord::MAX_MESSAGE));
+        std::copy_n(message.data(), record.length, record.text);
+        tail.store(position + 1, std::memory_order_release);
+    }
+
+    // 只能由消费者调用：取出当前所有记录追加到 out
+    void drain(std::vector<LogRecord>& out) {
+        const size_t position = head.load(std::memory_order_relaxed);
+        const size_t end = tail.load(std::memory_order_acquire);
+        for (size_t i = position; i != end; ++i) {
+            out.push_back(records[i & mask]);
+        }
+        head.store(end, std::memory_order_release);
+    }
+
+    [[nodiscard]] auto dropped_count() const -> std::uint64_t { return dropped.load(std::memory_order_relaxed); }
+};
+
+// 让 Args 只由实参推导，格式串本身不参与推导
+template <typename... Args>
+using format_string_t = FormatString<std::type_identity_t<Args>...>;
+
 // 日志记录器类
+// 默认同步输出；start_async 之后每个线程写自己的环形缓冲区，由后台线程按时间顺序统一输出
 class Logger {
 private:
     std::mutex log_mutex;
     LogLevel current_level = LogLevel::INFO;
 
+    // 异步模式的状态，只在没有其他线程写日志时切换
+    bool async = false;
+    LogOverflow overflow = LogOverflow::DROP;
+    size_t ring_capacity = 0;
+    std::uint64_t generation = 0;
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::atomic<bool> stopping{ false };
+    std::thread drainer;
+
 public:
+    Logger() = default;
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    ~Logger() { stop_async(); }
+
     void set_level(LogLevel level) { current_level = level; }
 
-    void log(LogLevel level, const std::string& message) {
-        if (level >= current_level) {
-            std::lock_guard<std::mutex> lock(log_mutex);
-            std::cout << "[" << level_to_string(level) << "] " << message << '\n';
+    void log(LogLevel level, std::string_view message) {
+        if (level < current_level) {
+            return;
+        }
+        if (async) {
+            local_ring().push(level, message, overflow);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(log_mutex);
+        std::cout << "[" << level_to_string(level) << "] " << message << '\n';
+    }
+
+    // 在其他线程开始写日志之前调用。capacity 是每个线程缓冲区能容纳的记录数
+    void start_async(size_t capacity, LogOverflow policy) {
+        static std::atomic<std::uint64_t> next_generation{ 1 };
+
+        ring_capacity = capacity;
+        overflow = policy;
+        generation = next_generation.fetch_add(1, std::memory_order_relaxed);
+        stopping.store(false, std::memory_order_relaxed);
+        drainer = std::thread([this]() { drain_loop(); });
+        async = true;
+    }
+
+    // 在其他线程都停止写日志之后调用：输出剩余记录，回到同步模式，并报告丢弃的记录数
+    void stop_async() {
+        if (!async) {
+            return;
+        }
+        stopping.store(true, std::memory_order_release);
+        drainer.join();
+        async = false;
+
+        const std::uint64_t dropped = dropped_records();
+        rings.clear();
+        if (dropped > 0) {
+            warning("{} log records were dropped because a log buffer was full", dropped);
         }
     }
 
-    // 支持格式化字符串的日志方法（兼容C++11/14/17）
+    // 异步模式下因缓冲区满而丢弃的记录数
+    auto dropped_records() -> std::uint64_t {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        std::uint64_t dropped = 0;
+        for (const auto& ring : rings) {
+            dropped += ring->dropped_count();
+        }
+        return dropped;
+    }
+
+    // 格式串在编译期检查；级别未开启时直接返回，不做任何格式化
     template <typename... Args>
-    void debug(const std::string& format, const Args&... args) {
-        log(LogLevel::DEBUG, format_string(format, args...));
+    void debug(format_string_t<Args...> format, const Args&... args) {
+        write(LogLevel::DEBUG, format, args...);
     }
 
     template <typename... Args>
-    void info(const std::string& format, const Args&... args) {
-        log(LogLevel::INFO, format_string(format, args...));
+    void info(format_string_t<Args...> format, const Args&... args) {
+        write(LogLevel::INFO, format, args...);
     }
 
     template <typename... Args>
-    void warning(const std::string& format, const Args&... args) {
-        log(LogLevel::WARNING, format_string(format, args...));
+    void warning(format_string_t<Args...> format, const Args&... args) {
+        write(LogLevel::WARNING, format, args...);
     }
 
     template <typename... Args>
-    void error(const std::string& format, const Args&... args) {
-        log(LogLevel::ERROR, format_string(format, args...));
+    void error(format_string_t<Args...> format, const Args&... args) {
+        write(LogLevel::ERROR, format, args...);
     }
 
 private:
-    // 辅助函数：格式化字符串
     template <typename... Args>
-    auto format_string(const std::string& format, const Args&... args)
-        -> std::string {
-        std::ostringstream oss;
-        format_helper(oss, format, args...);
-        return oss.str();
-    }
-
-    // 递归辅助函数
-    template <typename T, typename... Args>
-    static void format_helper(std::ostringstream& oss,
-                              const std::string& format,
-                              const T& value,
-                              const Args&... args) {
+    void write(LogLevel level, FormatString<Args...> format, const Args&... args) {
+        if (level < current_level) {
+            return;
+        }
+        // 每个线程复用同一块缓冲区，容量够用之后不再分配内存
+        thread_local std::string buffer;
+        buffer.clear();
+        format_to(buffer, format.get(), args...);
+        log(level, buffer);
+    }
+
+    // 依次把每个 "{}" 替换为对应参数，占位符个数已在编译期核对过
+    template <typename... Args>
+    static void format_to(std::string& out, std::string_view format, const Args&... args) {
+        ((format = append_until_placeholder(out, format), append_value(out, args)), ...);
+        out.append(format);
+    }
+
+    static auto append_until_placeholder(std::string& out, std::string_view format) -> std::string_view {
         size_t pos = format.find("{}");
-        if (pos != std::string::npos) {
-            oss << format.substr(0, pos) << value;
-            // 检查是否还有足够的参数来匹配剩余的占位符
-            if constexpr (sizeof...(args) > 0) {
-                format_helper(oss, format.substr(pos + 2), args...);
-            } else {
-                // 没有更多参数了，直接输出剩余格式字符串
-                oss << format.substr(pos + 2);
-            }
+        out.append(format.substr(0, pos));
+        return format.substr(pos + 2);
+    }
+
+    template <typename T>
+    static void append_value(std::string& out, const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            out.append(value ? "true" : "false");
+        } else if constexpr (std::is_same_v<T, char>) {
+            out.push_back(value);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            char digits[32];
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, end);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            out.append(std::string_view(value));
         } else {
-            oss << format;
+            static_assert(sizeof(T) == 0, "unsupported log argument type");
         }
     }
 
-    // 递归终止函数
-    static void format_helper(std::ostringstream& oss, const std::string& format) {
-        oss << format;
+    // 当前线程在本次异步模式下的缓冲区，第一次写日志时注册
+    auto local_ring() -> LogRing& {
+        thread_local LogRing* ring = nullptr;
+        thread_local std::uint64_t ring_generation = 0;
+
+        if (ring_generation != generation) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.push_back(std::make_unique<LogRing>(ring_capacity));
+            ring = rings.back().get();
+            ring_generation = generation;
+        }
+        return *ring;
+    }
+
+    // 后台线程：反复取出所有缓冲区的记录，跨缓冲区按时间戳归并后输出；空闲时短暂休眠。
+    // 记录先打时间戳再发布，发布得晚的记录可能落在已输出的更新记录之后，所以新记录先
+    // 在 pending 中停留 REORDER_WINDOW 再输出。只有写日志的线程在打时间戳与发布之间
+    // 停顿超过这个窗口时，输出才会乱序
+    void drain_loop() {
+        constexpr auto REORDER_WINDOW = std::chrono::milliseconds(10);
+
+        std::vector<LogRecord> pending;
+        std::string output;
+        while (true) {
+            const bool last_pass = stopping.load(std::memory_order_acquire);
+            const auto cutoff = std::chrono::steady_clock::now() - REORDER_WINDOW;
+            const size_t held = pending.size();
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                for (const auto& ring : rings) {
+                    ring->drain(pending);
+                }
+            }
+            const bool idle = pending.size() == held;
+
+            if (!idle) {
+                std::stable_sort(pending.begin(), pending.end(),
+                                 [](const LogRecord& lhs, const LogRecord& rhs) { return lhs.time < rhs.time; });
+            }
+            // 停止时所有线程都已写完，剩下的记录全部输出
+            const auto ready = last_pass ? pending.end()
+                                         : std::partition_point(pending.begin(), pending.end(),
+                                                                [cutoff](const LogRecord& record) {
+                                                                    return record.time <= cutoff;
+                                                                });
+            if (ready != pending.begin()) {
+                output.clear();
+                for (auto it = pending.begin(); it != ready; ++it) {
+                    output.append("[").append(level_to_string(it->level)).append("] ");
+                    output.append(it->text, it->length).push_back('\n');
+                }
+                std::cout << output;
+                pending.erase(pending.begin(), ready);
+            }
+
+            if (last_pass) {
+                break;
+            }
+            if (idle) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        std::cout.flush();
     }
 
-    static auto level_to_string(LogLevel level) -> std::string {
+    static auto level_to_string(LogLevel level) -> std::string_view {
         switch (level) {
             case LogLevel::DEBUG  : return "DEBUG";
             case LogLevel::INFO   : return "INFO";
@@ -100,42 +335,443 @@ private:
     }
 };
 
+// HDR 风格的对数线性直方图：每个 2 的幂区间均分为 32 个桶，相对误差约 3%，
+// 记录一次只是一次 relaxed 原子加，可由多个线程同时记录
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t{ 1 } << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(std::uint64_t value) {
+        counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        std::uint64_t current = max_value.load(std::memory_order_relaxed);
+        while (value > current && !max_value.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    // 小于 64 的值各占一个桶，更大的值按最高 6 位分桶
+    static auto bucket_of(std::uint64_t value) -> size_t {
+        if (value < 2 * SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const int shift = std::bit_width(value) - SUB_BUCKET_BITS - 1;
+        return static_cast<size_t>(shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+    }
+
+    // 桶内的最大值
+    static auto upper_bound_of(size_t bucket) -> std::uint64_t {
+        if (bucket < 2 * SUB_BUCKETS) {
+            return bucket;
+        }
+        const size_t shift = bucket / SUB_BUCKETS - 1;
+        const std::uint64_t lowest = static_cast<std::uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lowest + ((std::uint64_t{ 1 } << shift) - 1);
+    }
+
+    [[nodiscard]] auto count(size_t bucket) const -> std::uint64_t { return counts[bucket].load(std::memory_order_relaxed); }
+    [[nodiscard]] auto max() const -> std::uint64_t { return max_value.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> counts{};
+    std::atomic<std::uint64_t> max_value{ 0 };
+};
+
+// 若干 LatencyHistogram 合并后的快照，用于计算分位数
+class HistogramSnapshot {
+private:
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(LatencyHistogram::BUCKETS, 0);
+    std::uint64_t total = 0;
+    std::uint64_t max_value = 0;
+
+public:
+    void add(const LatencyHistogram& histogram) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            const std::uint64_t count = histogram.count(i);
+            counts[i] += count;
+            total += count;
+        }
+        max_value = std::max(max_value, histogram.max());
+    }
+
+    [[nodiscard]] auto count() const -> std::uint64_t { return total; }
+    [[nodiscard]] auto max() const -> std::uint64_t { return max_value; }
+
+    // q 取 0 到 1，返回所在桶的上界，不超过记录到的最大值
+    [[nodiscard]] auto percentile(double q) const -> std::uint64_t {
+        if (total == 0) {
+            return 0;
+        }
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total))));
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(LatencyHistogram::upper_bound_of(i), max_value);
+            }
+        }
+        return max_value;
+    }
+};
+
+// Jain 公平性指数：(Σx)² / (n·Σx²)，所有人相同时为 1，只有一人占满时为 1/n
+inline auto jain_index(const std::vector<double>& values) -> double {
+    double sum = 0;
+    double sum_of_squares = 0;
+    for (double value : values) {
+        sum += value;
+        sum_of_squares += value * value;
+    }
+    if (sum_of_squares == 0) {
+        return 1.0;
+    }
+    return sum * sum / (static_cast<double>(values.size()) * sum_of_squares);
+}
+
 // 统计信息类
+// 每位哲学家的计数器独占一条缓存行，只由该哲学家自己的线程更新，无需加锁；
+// 读取方通过 snapshot() 拿到每位哲学家各自一致的一份数据。
+// 等叉子时间和两餐间隔记录在分片的直方图里，相邻编号的哲学家落在不同分片上
 class DiningStats {
+public:
+    struct PhilosopherSnapshot {
+        int meals_eaten = 0;
+        std::chrono::milliseconds eating_time{ 0 };
+        std::chrono::milliseconds thinking_time{ 0 };
+        std::chrono::microseconds fork_wait_time{ 0 };
+        // 从模拟开始到最近一餐结束
+        std::chrono::microseconds finished_at{ 0 };
+
+        // 每秒吃几餐
+        [[nodiscard]] auto throughput() const -> double {
+            return finished_at.count() > 0 ? meals_eaten * 1e6 / static_cast<double>(finished_at.count()) : 0.0;
+        }
+    };
+
+    // 由快照汇总出的报告，print_stats、write_json 和 write_csv 共用
+    struct Report {
+        struct Distribution {
+            std::uint64_t count = 0;
+            std::uint64_t p50 = 0;
+            std::uint64_t p90 = 0;
+            std::uint64_t p99 = 0;
+            std::uint64_t max = 0;
+        };
+
+        std::vector<PhilosopherSnapshot> philosophers;
+        Distribution fork_wait_us;
+        Distribution meal_interval_us;
+        double throughput_min = 0;
+        double throughput_mean = 0;
+        double throughput_max = 0;
+        double jain_throughput = 1.0;
+        double jain_fork_wait = 1.0;
+    };
+
 private:
-    std::mutex stats_mutex;
-    std::vector<int> meals_eaten;
-    std::vector<std::chrono::milliseconds> total_eating_time;
-    std::vector<std::chrono::milliseconds> total_thinking_time;
+    static constexpr size_t MAX_SHARDS = 64;
+
+    // 单写者的 seqlock：写入期间 sequence 为奇数，读取方读到前后不一致就重试
+    struct alignas(64) PhilosopherCounters {
+        std::atomic<std::uint32_t> sequence{ 0 };
+        std::atomic<int> meals_eaten{ 0 };
+        std::atomic<std::int64_t> eating_ms{ 0 };
+        std::atomic<std::int64_t> thinking_ms{ 0 };
+        std::atomic<std::int64_t> fork_wait_us{ 0 };
+        std::atomic<std::int64_t> finished_at_us{ 0 };
+
+        template <typename Update>
+        void write(Update update) {
+            const std::uint32_t begin = sequence.load(std::memory_order_relaxed);
+            sequence.store(begin + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            update();
+            sequence.store(begin + 2, std::memory_order_release);
+        }
+
+        [[nodiscard]] auto read() const -> PhilosopherSnapshot {
+            while (true) {
+                const std::uint32_t begin = sequence.load(std::memory_order_acquire);
+                if ((begin & 1) == 0) {
+                    PhilosopherSnapshot snapshot{ meals_eaten.load(std::memory_order_relaxed),
+                                                  std::chrono::milliseconds(eating_ms.load(std::memory_order_relaxed)),
+                                                  std::chrono::milliseconds(thinking_ms.load(std::memory_order_relaxed)),
+                                                  std::chrono::microseconds(fork_wait_us.load(std::memory_order_relaxed)),
+                                                  std::chrono::microseconds(finished_at_us.load(std::memory_order_relaxed)) };
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (sequence.load(std::memory_order_relaxed) == begin) {
+                        return snapshot;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    struct alignas(64) HistogramShard {
+        LatencyHistogram fork_wait_us;
+        LatencyHistogram meal_interval_us;
+    };
+
+    std::chrono::steady_clock::time_point start;
+    std::vector<PhilosopherCounters> counters;
+    std::vector<HistogramShard> shards;
+
+    // 只有写者自己修改，读后写即可，不需要原子的读-改-写
+    template <typename T>
+    static void add(std::atomic<T>& counter, T value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    auto shard(int philosopher_id) -> HistogramShard& { return shards[static_cast<size_t>(philosopher_id) % shards.size()]; }
 
 public:
     explicit DiningStats(int num_philosophers)
-        : meals_eaten(num_philosophers, 0),
-          total_eating_time(num_philosophers, std::chrono::milliseconds(0)),
-          total_thinking_time(num_philosophers, std::chrono::milliseconds(0)) {}
+        : start(std::chrono::steady_clock::now()),
+          counters(num_philosophers),
+          shards(std::min(static_cast<size_t>(num_philosophers), MAX_SHARDS)) {}
 
-    void add_meal(int philosopher_id, std::chrono::milliseconds eating_time) {
-        std::lock_guard<std::mutex> lock(stats_mutex);
-        meals_eaten[philosopher_id]++;
-        total_eating_time[philosopher_id] += eating_time;
+    // 从模拟开始到 time 经过的时间，供 add_meal 使用
+    [[nodiscard]] auto elapsed(std::chrono::steady_clock::time_point time) const -> std::chrono::microseconds {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - start);
+    }
+
+    // 以下只能由哲学家 philosopher_id 自己的线程调用
+    void add_meal(int philosopher_id, std::chrono::milliseconds eating_time, std::chrono::microseconds finished_at) {
+        PhilosopherCounters& philosopher = counters[philosopher_id];
+        const std::int64_t previous = philosopher.finished_at_us.load(std::memory_order_relaxed);
+        if (philosopher.meals_eaten.load(std::memory_order_relaxed) > 0) {
+            shard(philosopher_id).meal_interval_us.record(static_cast<std::uint64_t>(finished_at.count() - previous));
+        }
+        philosopher.write([&]() {
+            add(philosopher.meals_eaten, 1);
+            add(philosopher.eating_ms, static_cast<std::int64_t>(eating_time.count()));
+            philosopher.finished_at_us.store(finished_at.count(), std::memory_order_relaxed);
+        });
     }
 
     void add_thinking_time(int philosopher_id, std::chrono::milliseconds thinking_time) {
-        std::lock_guard<std::mutex> lock(stats_mutex);
-        total_thinking_time[philosopher_id] += thinking_time;
+        PhilosopherCounters& philosopher = counters[philosopher_id];
+        philosopher.write([&]() { add(philosopher.thinking_ms, static_cast<std::int64_t>(thinking_time.count())); });
+    }
+
+    // 从想吃到拿起两把叉子所等待的时间
+    void add_fork_wait(int philosopher_id, std::chrono::microseconds wait_time) {
+        PhilosopherCounters& philosopher = counters[philosopher_id];
+        shard(philosopher_id).fork_wait_us.record(static_cast<std::uint64_t>(wait_time.count()));
+        philosopher.write([&]() { add(philosopher.fork_wait_us, static_cast<std::int64_t>(wait_time.count())); });
+    }
+
+    // 可在模拟进行中随时调用，每位哲学家的数据各自一致，但不同哲学家之间不是同一时刻的
+    [[nodiscard]] auto snapshot() const -> std::vector<PhilosopherSnapshot> {
+        std::vector<PhilosopherSnapshot> result;
+        result.reserve(counters.size());
+        for (const PhilosopherCounters& philosopher : counters) {
+            result.push_back(philosopher.read());
+        }
+        return result;
+    }
+
+    [[nodiscard]] auto report() const -> Report {
+        Report report;
+        report.philosophers = snapshot();
+
+        HistogramSnapshot fork_wait;
+        HistogramSnapshot meal_interval;
+        for (const HistogramShard& shard : shards) {
+            fork_wait.add(shard.fork_wait_us);
+            meal_interval.add(shard.meal_interval_us);
+        }
+        auto summarize = [](const HistogramSnapshot& histogram) {
+            return Report::Distribution{ histogram.count(), histogram.percentile(0.5), histogram.percentile(0.9),
+                                         histogram.percentile(0.99), histogram.max() };
+        };
+        report.fork_wait_us = summarize(fork_wait);
+        report.meal_interval_us = summarize(meal_interval);
+
+        std::vector<double> throughputs;
+        std::vector<double> fork_waits;
+        throughputs.reserve(report.philosophers.size());
+        fork_waits.reserve(report.philosophers.size());
+        for (const PhilosopherSnapshot& philosopher : report.philosophers) {
+            throughputs.push_back(philosopher.throughput());
+            fork_waits.push_back(static_cast<double>(philosopher.fork_wait_time.count()));
+        }
+        if (!throughputs.empty()) {
+            const auto [min, max] = std::minmax_element(throughputs.begin(), throughputs.end());
+            report.throughput_min = *min;
+            report.throughput_max = *max;
+            double sum = 0;
+            for (double throughput : throughputs) {
+                sum += throughput;
+            }
+            report.throughput_mean = sum / static_cast<double>(throughputs.size());
+        }
+        report.jain_throughput = jain_index(throughputs);
+        report.jain_fork_wait = jain_index(fork_waits);
+        return report;
     }
 
-    void print_stats() {
-        std::lock_guard<std::mutex> lock(stats_mutex);
+    void print_stats() const {
+        const Report report = this->report();
         std::cout << "\n=== Dining Statistics ===\n";
-        for (int i = 0; i < meals_eaten.size(); ++i) {
+        for (size_t i = 0; i < report.philosophers.size(); ++i) {
+            const PhilosopherSnapshot& philosopher = report.philosophers[i];
             std::cout << "Philosopher " << i << ": "
-                      << meals_eaten[i] << " meals, "
-                      << "eating: " << total_eating_time[i].count() << "ms, "
-                      << "thinking: " << total_thinking_time[i].count() << "ms\n";
+                      << philosopher.meals_eaten << " meals, "
+                      << "eating: " << philosopher.eating_time.count() << "ms, "
+                      << "thinking: " << philosopher.thinking_time.count() << "ms, "
+                      << "waiting: " << philosopher.fork_wait_time.count() / 1000 << "ms\n";
         }
+        print_distribution("Fork wait", report.fork_wait_us);
+        print_distribution("Meal interval", report.meal_interval_us);
+        std::cout << "Throughput (meals/s): min " << report.throughput_min
+                  << ", mean " << report.throughput_mean
+                  << ", max " << report.throughput_max << '\n'
+                  << "Jain's fairness index: throughput " << report.jain_throughput
+                  << ", fork wait " << report.jain_fork_wait << '\n';
         std::cout << "========================\n";
     }
+
+    void write_json(std::ostream& out) const {
+        const Report report = this->report();
+        out << "{\n  \"philosophers\": [";
+        for (size_t i = 0; i < report.philosophers.size(); ++i) {
+            const PhilosopherSnapshot& philosopher = report.philosophers[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << R"(    {"id": )" << i
+                << R"(, "meals": )" << philosopher.meals_eaten
+                << R"(, "eating_ms": )" << philosopher.eating_time.count()
+                << R"(, "thinking_ms": )" << philosopher.thinking_time.count()
+                << R"(, "fork_wait_us": )" << philosopher.fork_wait_time.count()
+                << R"(, "throughput": )" << philosopher.throughput() << '}';
+        }
+        out << "\n  ],\n";
+        write_json_distribution(out, "fork_wait_us", report.fork_wait_us);
+        write_json_distribution(out, "meal_interval_us", report.meal_interval_us);
+        out << R"(  "throughput": {"min": )" << report.throughput_min
+            << R"(, "mean": )" << report.throughput_mean
+            << R"(, "max": )" << report.throughput_max << "},\n"
+            << R"(  "fairness": {"jain_throughput": )" << report.jain_throughput
+            << R"(, "jain_fork_wait": )" << report.jain_fork_wait << "}\n}\n";
+    }
+
+    // 每行一个指标：scope,metric,value,unit，scope 为 all 或哲学家编号
+    void write_csv(std::ostream& out) const {
+        const Report report = this->report();
+        out << "scope,metric,value,unit\n";
+        for (size_t i = 0; i < report.philosophers.size(); ++i) {
+            const PhilosopherSnapshot& philosopher = report.philosophers[i];
+            out << i << ",meals," << philosopher.meals_eaten << ",count\n"
+                << i << ",eating," << philosopher.eating_time.count() << ",ms\n"
+                << i << ",thinking," << philosopher.thinking_time.count() << ",ms\n"
+                << i << ",fork_wait," << philosopher.fork_wait_time.count() << ",us\n"
+                << i << ",throughput," << philosopher.throughput() << ",meals/s\n";
+        }
+        write_csv_distribution(out, "fork_wait", report.fork_wait_us);
+        write_csv_distribution(out, "meal_interval", report.meal_interval_us);
+        out << "all,throughput_min," << report.throughput_min << ",meals/s\n"
+            << "all,throughput_mean," << report.throughput_mean << ",meals/s\n"
+            << "all,throughput_max," << report.throughput_max << ",meals/s\n"
+            << "all,jain_throughput," << report.jain_throughput << ",index\n"
+            << "all,jain_fork_wait," << report.jain_fork_wait << ",index\n";
+    }
+
+private:
+    static void print_distribution(const char* name, const Report::Distribution& distribution) {
+        std::cout << name << " (us, " << distribution.count << " samples): "
+                  << "p50 " << distribution.p50
+                  << ", p90 " << distribution.p90
+                  << ", p99 " << distribution.p99
+                  << ", max " << distribution.max << '\n';
+    }
+
+    static void write_json_distribution(std::ostream& out, const char* name, const Report::Distribution& distribution) {
+        out << "  \"" << name << R"(": {"count": )" << distribution.count
+            << R"(, "p50": )" << distribution.p50
+            << R"(, "p90": )" << distribution.p90
+            << R"(, "p99": )" << distribution.p99
+            << R"(, "max": )" << distribution.max << "},\n";
+    }
+
+    static void write_csv_distribution(std::ostream& out, const char* name, const Report::Distribution& distribution) {
+        out << "all," << name << "_count," << distribution.count << ",count\n"
+            << "all," << name << "_p50," << distribution.p50 << ",us\n"
+            << "all," << name << "_p90," << distribution.p90 << ",us\n"
+            << "all," << name << "_p99," << distribution.p99 << ",us\n"
+            << "all," << name << "_max," << distribution.max << ",us\n";
+    }
+};
+
+// 哲学家所处的阶段
+enum class Phase : std::uint8_t {
+    THINKING,
+    WAITING, // 等待叉子
+    EATING
+};
+
+// 时间线追踪器：记录每位哲学家的阶段切换，导出为 Chrome trace-event JSON，可用 Perfetto 或 chrome://tracing 打开
+// 每位哲学家只写自己的缓冲区，且缓冲区预先分配好，记录一次只是几次写内存，不加锁也不分配
+class Tracer {
+private:
+    // 相对 epoch 的时间
+    struct Span {
+        Phase phase;
+        std::chrono::microseconds begin;
+        std::chrono::microseconds end;
+    };
+
+    std::chrono::steady_clock::time_point epoch;
+    std::vector<std::vector<Span>> spans;
+
+public:
+    Tracer(int num_philosophers, int num_meals)
+        : epoch(std::chrono::steady_clock::now()),
+          spans(num_philosophers) {
+        for (auto& philosopher_spans : spans) {
+            // 每顿饭三个阶段
+            philosopher_spans.reserve(static_cast<size_t>(num_meals) * 3);
+        }
+    }
+
+    // 只能由哲学家 id 自己的线程调用
+    void record(int id, Phase phase, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+        record(id, phase, std::chrono::duration_cast<std::chrono::microseconds>(begin - epoch),
+               std::chrono::duration_cast<std::chrono::microseconds>(end - epoch));
+    }
+
+    // 模拟模式使用：begin 和 end 是虚拟时钟的时间
+    void record(int id, Phase phase, std::chrono::microseconds begin, std::chrono::microseconds end) {
+        spans[id].push_back({ phase, begin, end });
+    }
+
+    // 所有哲学家线程结束后调用，每位哲学家一条时间线
+    void write_json(std::ostream& out) const {
+        out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+        bool first = true;
+        for (size_t id = 0; id < spans.size(); ++id) {
+            out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << id
+                << R"(,"args":{"name":"Philosopher )" << id << R"("}})";
+            first = false;
+            for (const Span& span : spans[id]) {
+                out << R"(,
+{"name":")" << phase_to_string(span.phase) << R"(","ph":"X","pid":1,"tid":)" << id
+                    << R"(,"ts":)" << span.begin.count() << R"(,"dur":)" << (span.end - span.begin).count()
+                    << '}';
+            }
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    static auto phase_to_string(Phase phase) -> const char* {
+        switch (phase) {
+            case Phase::THINKING: return "thinking";
+            case Phase::WAITING : return "waiting for forks";
+            case Phase::EATING  : return "eating";
+            default             : return "unknown";
+        }
+    }
 };
 
 // 配置结构体
@@ -146,6 +782,15 @@ struct DiningConfig {
     int max_think_eat_time = 3;
     LogLevel log_level = LogLevel::INFO;
     bool enable_stats = true;
+    std::string trace_file; // 为空时不记录时间线
+    bool simulate = false;  // 用离散事件模拟代替真实线程
+    // 未指定 --seed 时随机选取，并打印在日志里以便复现
+    std::uint64_t seed = std::random_device{}();
+    std::string stats_json_file; // 为空时不导出
+    std::string stats_csv_file;
+    bool async_log = false;
+    LogOverflow log_overflow = LogOverflow::DROP;
+    int log_buffer = 128; // 异步模式下每个线程的缓冲区容量（条），每条约 224 字节
 
     static auto from_args(int argc, char* argv[]) -> DiningConfig {
         DiningConfig config;
@@ -173,6 +818,29 @@ struct DiningConfig {
                         config.log_level = LogLevel::ERROR;
                     }
                 }
+            } else if (arg == "--async-log") {
+                config.async_log = true;
+            } else if (arg == "--log-overflow" && i + 1 < argc) {
+                std::string policy = argv[++i];
+                if (policy == "drop") {
+                    config.log_overflow = LogOverflow::DROP;
+                } else if (policy == "block") {
+                    config.log_overflow = LogOverflow::BLOCK;
+                } else {
+                    throw std::invalid_argument("Log overflow policy must be drop or block");
+                }
+            } else if (arg == "--log-buffer" && i + 1 < argc) {
+                config.log_buffer = std::stoi(argv[++i]);
+            } else if (arg == "--stats-json" && i + 1 < argc) {
+                config.stats_json_file = argv[++i];
+            } else if (arg == "--stats-csv" && i + 1 < argc) {
+                config.stats_csv_file = argv[++i];
+            } else if (arg == "--simulate") {
+                config.simulate = true;
+            } else if (arg == "--seed" && i + 1 < argc) {
+                config.seed = std::stoull(argv[++i]);
+            } else if (arg == "--trace" && i + 1 < argc) {
+                config.trace_file = argv[++i];
             } else if (arg == "--no-stats") {
                 config.enable_stats = false;
             } else if (arg == "--help") {
@@ -194,6 +862,9 @@ struct DiningConfig {
         if (config.min_think_eat_time > config.max_think_eat_time) {
             throw std::invalid_argument("Min time cannot be greater than max time");
         }
+        if (config.log_buffer <= 0) {
+            throw std::invalid_argument("Log buffer size must be positive");
+        }
 
         return config;
     }
@@ -208,39 +879,77 @@ private:
                   << "  --max-time N        Maximum think/eat time in seconds (default: 3)\n"
                   << "  --log-level LEVEL   Log level (debug|info|warning|error) (default: info)\n"
                   << "  --no-stats          Disable statistics collection\n"
+                  << "  --async-log         Log through per-thread buffers and a background writer\n"
+                  << "                      (lines are ordered by time, with a 10 ms reorder window)\n"
+                  << "  --log-overflow P    When an async log buffer is full: drop|block (default: drop)\n"
+                  << "  --log-buffer N      Records per thread in async log mode (default: 128)\n"
+                  << "  --stats-json FILE   Write statistics, percentiles and fairness as JSON\n"
+                  << "  --stats-csv FILE    Write statistics, percentiles and fairness as CSV\n"
+                  << "  --simulate          Run a discrete-event simulation on a virtual clock instead of threads\n"
+                  << "  --seed N            Seed for the philosophers' random streams (default: random)\n"
+                  << "  --trace FILE        Write a Chrome trace-event timeline (open in Perfetto)\n"
                   << "  --help              Show this help message\n";
     }
 };
 
+// SplitMix64 随机数流：每位哲学家一条，由种子和编号决定，状态只有 8 字节
+class RandomStream {
+private:
+    static constexpr std::uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+    std::uint64_t state;
+
+    static auto mix(std::uint64_t z) -> std::uint64_t {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+public:
+    using result_type = std::uint64_t;
+
+    // 先打散流编号，避免相邻编号的流只是同一序列错开几位
+    RandomStream(std::uint64_t seed, std::uint64_t stream)
+        : state(seed ^ mix(stream + GOLDEN_GAMMA)) {}
+
+    static constexpr auto min() -> result_type { return 0; }
+    static constexpr auto max() -> result_type { return ~result_type{ 0 }; }
+
+    auto operator()() -> result_type { return mix(state += GOLDEN_GAMMA); }
+};
+
 // 哲学家类
 class Philosopher {
 private:
     int id;
     int left_fork;
     int right_fork;
-    std::mt19937 gen;
+    RandomStream gen;
     std::uniform_int_distribution<> dis;
     Logger& logger;
     DiningStats& stats;
     const DiningConfig& config;
+    Tracer* tracer; // 不记录时间线时为 nullptr
 
 public:
     Philosopher(int id,
                 int num_philosophers,
                 Logger& logger,
                 DiningStats& stats,
-                const DiningConfig& config)
+                const DiningConfig& config,
+                Tracer* tracer)
         : id(id),
           left_fork(id),
           right_fork((id + 1) % num_philosophers),
-          gen(std::random_device{}()),
+          gen(config.seed, static_cast<std::uint64_t>(id)),
           dis(config.min_think_eat_time, config.max_think_eat_time),
           logger(logger),
           stats(stats),
-          config(config) {}
+          config(config),
+          tracer(tracer) {}
 
     void dine(std::vector<std::mutex>& forks) {
-        logger.debug("Philosopher " + std::to_string(id) + " starting dining session");
+        logger.debug("Philosopher {} starting dining session", id);
 
         for (int meal = 0; meal < config.num_meals; ++meal) {
             try {
@@ -253,15 +962,28 @@ public:
 
                 // 获取叉子 - 使用std::scoped_lock确保原子性
                 logger.debug("Philosopher {} attempting to acquire forks", id);
-                std::scoped_lock lock(forks[left_fork], forks[right_fork]);
-                logger.info("Philosopher {} picked up both forks", id);
+                std::chrono::steady_clock::time_point eat_start;
+                std::chrono::steady_clock::time_point eat_end;
+                {
+                    std::scoped_lock lock(forks[left_fork], forks[right_fork]);
+                    eat_start = std::chrono::steady_clock::now();
+                    logger.info("Philosopher {} picked up both forks", id);
 
-                // 用餐阶段
-                auto eat_start = std::chrono::steady_clock::now();
-                logger.info("Philosopher {} is eating meal {}...", id, meal + 1);
-                std::this_thread::sleep_for(std::chrono::seconds(dis(gen)));
-                auto eat_end = std::chrono::steady_clock::now();
-                stats.add_meal(id, std::chrono::duration_cast<std::chrono::milliseconds>(eat_end - eat_start));
+                    // 用餐阶段
+                    logger.info("Philosopher {} is eating meal {}...", id, meal + 1);
+                    std::this_thread::sleep_for(std::chrono::seconds(dis(gen)));
+                    eat_end = std::chrono::steady_clock::now();
+                }
+
+                // 放下叉子之后再记录统计和追踪，不拉长持有叉子的时间
+                stats.add_fork_wait(id, std::chrono::duration_cast<std::chrono::microseconds>(eat_start - think_end));
+                stats.add_meal(id, std::chrono::duration_cast<std::chrono::milliseconds>(eat_end - eat_start), stats.elapsed(eat_end));
+
+                if (tracer != nullptr) {
+                    tracer->record(id, Phase::THINKING, think_start, think_end);
+                    tracer->record(id, Phase::WAITING, think_end, eat_start);
+                    tracer->record(id, Phase::EATING, eat_start, eat_end);
+                }
 
                 logger.info("Philosopher {} finished eating and put down forks", id);
 
@@ -275,6 +997,167 @@ public:
     }
 };
 
+// 离散事件模拟：用事件队列和虚拟时钟代替线程和 sleep，思考和用餐时长与线程模式取自同样的随机数流，
+// 同一种子的结果完全相同。饥饿的哲学家在两把叉子都空闲时拿起它们，否则等待，
+// 邻座放下叉子时先饿的一方先尝试
+class DiningSimulation {
+private:
+    enum class EventType : std::uint8_t {
+        HUNGRY,     // 思考结束
+        DONE_EATING // 用餐结束，放下叉子
+    };
+
+    struct Event {
+        std::chrono::microseconds time;
+        std::uint64_t sequence; // 同一时刻的事件按加入顺序处理
+        int philosopher;
+        EventType type;
+    };
+
+    struct Later {
+        auto operator()(const Event& lhs, const Event& rhs) const -> bool {
+            if (lhs.time != rhs.time) {
+                return lhs.time > rhs.time;
+            }
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    struct PhilosopherState {
+        RandomStream gen;
+        int meals_eaten = 0;
+        bool hungry = false;
+        std::chrono::microseconds think_start{ 0 };
+        std::chrono::microseconds hungry_since{ 0 };
+        std::chrono::microseconds eat_start{ 0 };
+    };
+
+    const DiningConfig& config;
+    Logger& logger;
+    DiningStats& stats;
+    Tracer* tracer;
+    std::uniform_int_distribution<> dis;
+    std::vector<PhilosopherState> philosophers;
+    std::vector<bool> fork_in_use;
+    std::priority_queue<Event, std::vector<Event>, Later> events;
+    std::uint64_t next_sequence = 0;
+    std::chrono::microseconds now{ 0 };
+
+public:
+    DiningSimulation(const DiningConfig& config, Logger& logger, DiningStats& stats, Tracer* tracer)
+        : config(config),
+          logger(logger),
+          stats(stats),
+          tracer(tracer),
+          dis(config.min_think_eat_time, config.max_think_eat_time),
+          fork_in_use(config.num_philosophers, false) {
+        philosophers.reserve(config.num_philosophers);
+        for (int i = 0; i < config.num_philosophers; ++i) {
+            philosophers.push_back(PhilosopherState{ RandomStream(config.seed, static_cast<std::uint64_t>(i)) });
+        }
+    }
+
+    // 运行到所有哲学家吃完，返回虚拟时钟的结束时间
+    auto run() -> std::chrono::microseconds {
+        for (int i = 0; i < config.num_philosophers; ++i) {
+            start_thinking(i);
+        }
+        while (!events.empty()) {
+            const Event event = events.top();
+            events.pop();
+            now = event.time;
+            if (event.type == EventType::HUNGRY) {
+                on_hungry(event.philosopher);
+            } else {
+                on_done_eating(event.philosopher);
+            }
+        }
+        return now;
+    }
+
+private:
+    auto left_fork(int id) const -> int { return id; }
+    auto right_fork(int id) const -> int { return (id + 1) % config.num_philosophers; }
+
+    void schedule(std::chrono::microseconds time, int id, EventType type) {
+        events.push(Event{ time, next_sequence++, id, type });
+    }
+
+    auto draw_duration(PhilosopherState& philosopher) -> std::chrono::microseconds {
+        return std::chrono::seconds(dis(philosopher.gen));
+    }
+
+    void start_thinking(int id) {
+        PhilosopherState& philosopher = philosophers[id];
+        philosopher.think_start = now;
+        logger.debug("[{}us] Philosopher {} is thinking...", now.count(), id);
+        schedule(now + draw_duration(philosopher), id, EventType::HUNGRY);
+    }
+
+    void on_hungry(int id) {
+        PhilosopherState& philosopher = philosophers[id];
+        stats.add_thinking_time(id, std::chrono::duration_cast<std::chrono::milliseconds>(now - philosopher.think_start));
+        if (tracer != nullptr) {
+            tracer->record(id, Phase::THINKING, philosopher.think_start, now);
+        }
+        philosopher.hungry = true;
+        philosopher.hungry_since = now;
+        logger.debug("[{}us] Philosopher {} attempting to acquire forks", now.count(), id);
+        try_eat(id);
+    }
+
+    // 两把叉子都空闲时拿起叉子开始用餐
+    auto try_eat(int id) -> bool {
+        PhilosopherState& philosopher = philosophers[id];
+        if (!philosopher.hungry || fork_in_use[left_fork(id)] || fork_in_use[right_fork(id)]) {
+            return false;
+        }
+        fork_in_use[left_fork(id)] = true;
+        fork_in_use[right_fork(id)] = true;
+        philosopher.hungry = false;
+        philosopher.eat_start = now;
+
+        stats.add_fork_wait(id, now - philosopher.hungry_since);
+        if (tracer != nullptr) {
+            tracer->record(id, Phase::WAITING, philosopher.hungry_since, now);
+        }
+        logger.debug("[{}us] Philosopher {} is eating meal {}...", now.count(), id, philosopher.meals_eaten + 1);
+        schedule(now + draw_duration(philosopher), id, EventType::DONE_EATING);
+        return true;
+    }
+
+    void on_done_eating(int id) {
+        PhilosopherState& philosopher = philosophers[id];
+        fork_in_use[left_fork(id)] = false;
+        fork_in_use[right_fork(id)] = false;
+        ++philosopher.meals_eaten;
+
+        stats.add_meal(id, std::chrono::duration_cast<std::chrono::milliseconds>(now - philosopher.eat_start), now);
+        if (tracer != nullptr) {
+            tracer->record(id, Phase::EATING, philosopher.eat_start, now);
+        }
+        logger.debug("[{}us] Philosopher {} finished eating and put down forks", now.count(), id);
+
+        if (philosopher.meals_eaten < config.num_meals) {
+            start_thinking(id);
+        } else {
+            logger.debug("[{}us] Philosopher {} has finished all meals", now.count(), id);
+        }
+
+        // 叉子空出来了，邻座中先饿的先尝试
+        const int left = (id + config.num_philosophers - 1) % config.num_philosophers;
+        const int right = right_fork(id);
+        if (philosophers[right].hungry
+            && (!philosophers[left].hungry || philosophers[right].hungry_since < philosophers[left].hungry_since)) {
+            try_eat(right);
+            try_eat(left);
+        } else {
+            try_eat(left);
+            try_eat(right);
+        }
+    }
+};
+
 // 餐厅管理类
 class DiningPhilosophers {
 private:
@@ -282,27 +1165,62 @@ private:
     Logger logger;
     DiningStats stats;
     const DiningConfig config;
+    std::unique_ptr<Tracer> tracer;
 
 public:
     explicit DiningPhilosophers(const DiningConfig& config)
         : config(config),
           stats(config.num_philosophers),
-          forks(config.num_philosophers) {
+          forks(config.simulate ? 0 : config.num_philosophers) {
 
+        if (!config.trace_file.empty()) {
+            tracer = std::make_unique<Tracer>(config.num_philosophers, config.num_meals);
+        }
         logger.set_level(config.log_level);
         logger.info("Initializing dining simulation with {} philosophers", config.num_philosophers);
+        logger.info("Random seed: {}", config.seed);
     }
 
     void run() {
+        logger.info("Starting dining simulation...");
+
+        if (config.async_log) {
+            logger.start_async(config.log_buffer, config.log_overflow);
+        }
+
+        if (config.simulate) {
+            run_simulation();
+        } else {
+            run_threads();
+        }
+        logger.stop_async();
+
+        logger.info("All philosophers have finished dining");
+
+        if (config.enable_stats) {
+            stats.print_stats();
+        }
+
+        if (!config.stats_json_file.empty()) {
+            write_file(config.stats_json_file, "Statistics", [this](std::ostream& out) { stats.write_json(out); });
+        }
+        if (!config.stats_csv_file.empty()) {
+            write_file(config.stats_csv_file, "Statistics", [this](std::ostream& out) { stats.write_csv(out); });
+        }
+        if (tracer) {
+            write_file(config.trace_file, "Timeline", [this](std::ostream& out) { tracer->write_json(out); });
+        }
+    }
+
+private:
+    void run_threads() {
         std::vector<std::thread> philosophers;
         philosophers.reserve(config.num_philosophers);
 
-        logger.info("Starting dining simulation...");
-
         // 创建哲学家线程
         for (int i = 0; i < config.num_philosophers; ++i) {
             philosophers.emplace_back([this, i]() {
-                Philosopher philosopher(i, config.num_philosophers, logger, stats, config);
+                Philosopher philosopher(i, config.num_philosophers, logger, stats, config, tracer.get());
                 philosopher.dine(forks);
             });
         }
@@ -311,12 +1229,26 @@ public:
         for (auto& p : philosophers) {
             p.join();
         }
+    }
 
-        logger.info("All philosophers have finished dining");
+    void run_simulation() {
+        const auto wall_start = std::chrono::steady_clock::now();
+        DiningSimulation simulation(config, logger, stats, tracer.get());
+        const std::chrono::microseconds virtual_time = simulation.run();
+        const auto wall_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wall_start);
+        logger.info("Simulated {} meals over {}s of virtual time in {}ms",
+                    static_cast<std::int64_t>(config.num_philosophers) * config.num_meals,
+                    virtual_time.count() / 1000000, wall_time.count());
+    }
 
-        if (config.enable_stats) {
-            stats.print_stats();
+    template <typename Write>
+    void write_file(const std::string& path, const char* what, Write write) {
+        std::ofstream out(path);
+        if (!out) {
+            throw std::runtime_error("Cannot open file: " + path);
         }
+        write(out);
+        logger.info("{} written to {}", what, path);
     }
 };
 
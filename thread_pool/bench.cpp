@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <latch>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coro_task.hpp"
+#include "parallel.hpp"
+#include "strand.hpp"
+#include "task_future.hpp"
+#include "thread_pool.hpp"
+
+// gcc sees malloc/free behind the replaced operators and flags every delete
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// count every global allocation so we can report allocations per task
+static std::atomic<size_t> g_allocations{ 0 };
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t /*size*/) noexcept { std::free(ptr); }
+
+namespace {
+
+    constexpr int TASK_COUNT = 200000;
+
+    constexpr SchedulingMode ALL_MODES[] = {
+        SchedulingMode::SHARED_QUEUE,
+        SchedulingMode::WORK_STEALING,
+        SchedulingMode::BOUNDED_QUEUE
+    };
+
+    // one measurement. every benchmark adds rows, main prints them as CSV or JSON
+    struct Row {
+        std::string benchmark;
+        std::string mode;
+        size_t threads;
+        // what varies within the benchmark, like "submitters=4", empty if nothing does
+        std::string param;
+        std::string metric;
+        double value;
+        std::string unit;
+    };
+
+    // the rows of the running benchmark, printed and cleared as soon as it finishes
+    std::vector<Row> g_rows;
+
+    auto mode_name(SchedulingMode mode) -> const char* {
+        switch (mode) {
+            case SchedulingMode::SHARED_QUEUE : return "shared";
+            case SchedulingMode::WORK_STEALING: return "stealing";
+            case SchedulingMode::BOUNDED_QUEUE: return "bounded";
+        }
+        return "unknown";
+    }
+
+    auto hardware_threads() -> size_t {
+        return std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    // 1, 2, 4, ... up to and including `max`
+    auto doubling_up_to(size_t max) -> std::vector<size_t> {
+        std::vector<size_t> counts;
+        for (size_t count = 1; count < max; count *= 2) {
+            counts.push_back(count);
+        }
+        counts.push_back(max);
+        return counts;
+    }
+
+    auto seconds_since(std::chrono::steady_clock::time_point start) -> double {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // sorts the samples, q in [0, 1]
+    auto quantile(std::vector<double>& samples, double q) -> double {
+        std::sort(samples.begin(), samples.end());
+        return samples[static_cast<size_t>(q * static_cast<double>(samples.size() - 1))];
+    }
+
+    // tasks/s and allocations per task for `tasks` tasks submitted and finished by run()
+    template <typename Run>
+    void throughput(const std::string& benchmark, const std::string& mode, size_t threads,
+                    const std::string& param, size_t tasks, Run run) {
+        const size_t before = g_allocations.load();
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const double seconds = seconds_since(start);
+        const size_t after = g_allocations.load();
+
+        g_rows.push_back({ benchmark, mode, threads, param, "throughput",
+                           static_cast<double>(tasks) / seconds, "tasks/s" });
+        g_rows.push_back({ benchmark, mode, threads, param, "allocations",
+                           static_cast<double>(after - before) / static_cast<double>(tasks), "allocs/task" });
+    }
+
+    // what enqueue() used to build for every task, a std::function around a shared
+    // packaged_task, posted through the same pool loop as today's InlineTask storage,
+    // so the two rows only differ in how a task is stored
+    void legacy_task_storage() {
+        const auto work = [](int x) { return x + 1; };
+
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+            std::vector<std::future<int>> futures;
+            futures.reserve(TASK_COUNT);
+
+            throughput("legacy_task_storage", mode_name(mode), pool.size(), "storage=legacy", TASK_COUNT, [&]() {
+                for (int i = 0; i < TASK_COUNT; ++i) {
+                    auto task = std::make_shared<std::packaged_task<int()>>(
+                        [work, i]() -> int { return std::invoke(work, i); });
+                    futures.emplace_back(task->get_future());
+                    pool.post(std::function<void()>([task]() { (*task)(); }));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+            });
+
+            futures.clear();
+            throughput("legacy_task_storage", mode_name(mode), pool.size(), "storage=inline", TASK_COUNT, [&]() {
+                for (int i = 0; i < TASK_COUNT; ++i) {
+                    futures.emplace_back(pool.enqueue(work, i));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+            });
+        }
+    }
+
+    // the cost of the pool itself: tasks that do nothing, one future each
+    void empty_task() {
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+            std::vector<std::future<void>> futures;
+            futures.reserve(TASK_COUNT);
+
+            throughput("empty_task", mode_name(mode), pool.size(), "", TASK_COUNT, [&]() {
+                for (int i = 0; i < TASK_COUNT; ++i) {
+                    futures.emplace_back(pool.enqueue([]() {}));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+            });
+        }
+    }
+
+    void enqueue_bulk() {
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+
+            throughput("enqueue_bulk", mode_name(mode), pool.size(), "", TASK_COUNT, [&]() {
+                auto futures = pool.enqueue_bulk(TASK_COUNT, [](size_t x) { return x + 1; });
+                for (auto& future : futures) {
+                    future.get();
+                }
+            });
+        }
+    }
+
+    // one round submits a task per worker (times four) and waits for all of them
+    void fan_out_fan_in() {
+        constexpr int ROUNDS = 2000;
+
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+            const size_t fan = pool.size() * 4;
+
+            std::vector<double> latencies;
+            latencies.reserve(ROUNDS);
+            std::vector<std::future<void>> futures;
+            futures.reserve(fan);
+            for (int round = 0; round < ROUNDS; ++round) {
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < fan; ++i) {
+                    futures.emplace_back(pool.enqueue([]() {}));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+                latencies.push_back(seconds_since(start) * 1e6);
+                futures.clear();
+            }
+
+            const std::string param = "fan=" + std::to_string(fan);
+            g_rows.push_back({ "fan_out_fan_in", mode_name(mode), pool.size(), param, "p50",
+                               quantile(latencies, 0.5), "us" });
+            g_rows.push_back({ "fan_out_fan_in", mode_name(mode), pool.size(), param, "p99",
+                               quantile(latencies, 0.99), "us" });
+        }
+    }
+
+    // `submitters` threads enqueue TASK_COUNT tasks between them, all starting at once
+    void contention(const char* benchmark, SchedulingMode mode, size_t workers, size_t submitters) {
+        ThreadPool pool(workers, mode);
+        const size_t per_submitter = TASK_COUNT / submitters;
+        std::latch start_line(static_cast<std::ptrdiff_t>(submitters) + 1);
+
+        std::vector<std::thread> threads;
+        threads.reserve(submitters);
+        for (size_t s = 0; s < submitters; ++s) {
+            threads.emplace_back([&]() {
+                std::vector<std::future<void>> futures;
+                futures.reserve(per_submitter);
+                start_line.arrive_and_wait();
+                for (size_t i = 0; i < per_submitter; ++i) {
+                    futures.emplace_back(pool.enqueue([]() {}));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+            });
+        }
+
+        throughput(benchmark, mode_name(mode), workers, "submitters=" + std::to_string(submitters),
+                   per_submitter * submitters, [&]() {
+                       start_line.arrive_and_wait();
+                       for (std::thread& thread : threads) {
+                           thread.join();
+                       }
+                   });
+    }
+
+    // many submitters fighting over the queues of a single worker
+    void contention_producer_heavy() {
+        for (SchedulingMode mode : ALL_MODES) {
+            for (size_t submitters : doubling_up_to(hardware_threads())) {
+                contention("contention_producer_heavy", mode, 1, submitters);
+            }
+        }
+    }
+
+    // every worker competing for what a few submitters produce
+    void contention_consumer_heavy() {
+        for (SchedulingMode mode : ALL_MODES) {
+            for (size_t submitters : doubling_up_to(hardware_threads())) {
+                contention("contention_consumer_heavy", mode, hardware_threads(), submitters);
+            }
+        }
+    }
+
+    // a binary tree of tasks where every task enqueues its two children from the worker
+    void recursive_spawn() {
+        constexpr int DEPTH = 16;
+        constexpr size_t NODES = (size_t{ 1 } << (DEPTH + 1)) - 1;
+
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+            std::atomic<size_t> remaining{ NODES };
+            std::promise<void> done;
+
+            std::function<void(int)> node = [&](int depth) {
+                if (depth > 0) {
+                    pool.enqueue(node, depth - 1);
+                    pool.enqueue(node, depth - 1);
+                }
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    done.set_value();
+                }
+            };
+
+            throughput("recursive_spawn", mode_name(mode), pool.size(), "depth=" + std::to_string(DEPTH), NODES,
+                       [&]() {
+                           pool.enqueue(node, DEPTH);
+                           done.get_future().get();
+                       });
+        }
+    }
+
+    // divide and conquer where every task waits for its subtasks with TaskFuture::get(),
+    // which keeps the worker busy with queued tasks instead of blocking it
+    void nested_wait() {
+        constexpr int DEPTH = 14;
+        constexpr size_t NODES = (size_t{ 1 } << (DEPTH + 1)) - 1;
+
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+
+            std::function<size_t(int)> node = [&](int depth) -> size_t {
+                if (depth == 0) {
+                    return 1;
+                }
+                auto left = spawn(pool, node, depth - 1);
+                auto right = spawn(pool, node, depth - 1);
+                return left.get() + right.get() + 1;
+            };
+
+            throughput("nested_wait", mode_name(mode), pool.size(), "depth=" + std::to_string(DEPTH), NODES,
+                       [&]() { spawn(pool, node, DEPTH).get(); });
+        }
+    }
+
+    // nested_wait with the task memory on the global heap and in per-worker arenas,
+    // where the futures' states are mostly freed on another worker than they came from
+    void task_memory() {
+        constexpr int DEPTH = 14;
+        constexpr size_t NODES = (size_t{ 1 } << (DEPTH + 1)) - 1;
+
+        for (SchedulingMode mode : ALL_MODES) {
+            for (const bool arenas : { false, true }) {
+                ThreadPoolConfig config;
+                config.threads = hardware_threads();
+                config.mode = mode;
+                if (arenas) {
+                    config.memory_resource = std::pmr::new_delete_resource();
+                }
+                ThreadPool pool(config);
+
+                std::function<size_t(int)> node = [&](int depth) -> size_t {
+                    if (depth == 0) {
+                        return 1;
+                    }
+                    auto left = spawn(pool, node, depth - 1);
+                    auto right = spawn(pool, node, depth - 1);
+                    return left.get() + right.get() + 1;
+                };
+
+                throughput("task_memory", mode_name(mode), pool.size(), arenas ? "memory=arenas" : "memory=heap",
+                           NODES, [&]() { spawn(pool, node, DEPTH).get(); });
+            }
+        }
+    }
+
+    // TASK_COUNT tasks spread over many strands, each strand running its share in order
+    void strands() {
+        constexpr size_t STRANDS = 1000;
+
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+            std::vector<Strand> strands;
+            strands.reserve(STRANDS);
+            for (size_t i = 0; i < STRANDS; ++i) {
+                strands.emplace_back(pool);
+            }
+
+            throughput("strand", mode_name(mode), pool.size(), "strands=" + std::to_string(STRANDS), TASK_COUNT,
+                       [&]() {
+                           for (int i = 0; i < TASK_COUNT; ++i) {
+                               strands[static_cast<size_t>(i) % STRANDS].post([]() {});
+                           }
+                           pool.wait_idle();
+                       });
+        }
+    }
+
+    // the same empty task with no future (post), behind std::future, TaskFuture,
+    // and a chain of then() continuations
+    void future_overhead() {
+        for (SchedulingMode mode : ALL_MODES) {
+            ThreadPool pool(hardware_threads(), mode);
+
+            throughput("future_overhead", mode_name(mode), pool.size(), "future=none", TASK_COUNT, [&]() {
+                for (int i = 0; i < TASK_COUNT; ++i) {
+                    pool.post([]() {});
+                }
+                pool.wait_idle();
+            });
+            {
+                std::vector<std::future<int>> futures;
+                futures.reserve(TASK_COUNT);
+                throughput("future_overhead", mode_name(mode), pool.size(), "future=std", TASK_COUNT, [&]() {
+                    for (int i = 0; i < TASK_COUNT; ++i) {
+                        futures.emplace_back(pool.enqueue([i]() { return i; }));
+                    }
+                    for (auto& future : futures) {
+                        future.get();
+                    }
+                });
+            }
+            {
+                std::vector<TaskFuture<int>> futures;
+                futures.reserve(TASK_COUNT);
+                throughput("future_overhead", mode_name(mode), pool.size(), "future=task_future", TASK_COUNT,
+                           [&]() {
+                               for (int i = 0; i < TASK_COUNT; ++i) {
+                                   futures.push_back(spawn(pool, [i]() { return i; }));
+                               }
+                               for (auto& future : futures) {
+                                   future.get();
+                               }
+                           });
+            }
+            {
+                // every link waits for the previous one, so this is latency bound
+                constexpr int LINKS = TASK_COUNT / 10;
+                throughput("future_overhead", mode_name(mode), pool.size(), "future=then_chain", LINKS, [&]() {
+                    TaskFuture<int> future = make_ready_future(pool, 0);
+                    for (int i = 0; i < LINKS; ++i) {
+                        future = future.then([](int x) { return x + 1; });
+                    }
+                    future.get();
+                });
+            }
+        }
+    }
+
+    // parallel_for over a compute-bound loop, reported as speedup over one thread
+    void parallel_for_scaling() {
+        constexpr size_t ELEMENTS = 1 << 22;
+        std::vector<double> data(ELEMENTS);
+
+        auto run = [&](size_t threads) -> double {
+            ThreadPool pool(threads - 1);
+            auto start = std::chrono::steady_clock::now();
+            parallel_for(pool, size_t{ 0 }, ELEMENTS, [&](size_t i) {
+                double x = static_cast<double>(i);
+                for (int k = 0; k < 32; ++k) {
+                    x = x * 0.999 + 1.0;
+                }
+                data[i] = x;
+            });
+            return seconds_since(start);
+        };
+
+        const double serial = run(1);
+        for (size_t threads : doubling_up_to(hardware_threads())) {
+            const double seconds = run(threads);
+            g_rows.push_back({ "parallel_for", "shared", threads, "", "time", seconds * 1000.0, "ms" });
+            g_rows.push_back({ "parallel_for", "shared", threads, "", "speedup", serial / seconds, "x" });
+        }
+    }
+
+    // many logical operations sharing the workers: each one hops onto the pool twice
+    void coroutine_fan_out() {
+        constexpr int OPERATIONS = 50000;
+        ThreadPool pool(hardware_threads(), SchedulingMode::WORK_STEALING);
+
+        auto operation = [](ThreadPool& pool, int i) -> Task<int> {
+            co_await pool.schedule();
+            co_await pool.schedule();
+            co_return i;
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<Task<int>> operations;
+        operations.reserve(OPERATIONS);
+        for (int i = 0; i < OPERATIONS; ++i) {
+            operations.push_back(operation(pool, i));
+        }
+        auto results = sync_wait(when_all(std::move(operations)));
+        const double seconds = seconds_since(start);
+
+        g_rows.push_back({ "coroutine_fan_out", "stealing", pool.size(),
+                           "operations=" + std::to_string(results.size()), "throughput",
+                           OPERATIONS / seconds, "ops/s" });
+    }
+
+    // submit-to-start latency with idle workers, parking vs spinning before parking
+    void wakeup_latency() {
+        constexpr int SAMPLES = 20000;
+
+        for (SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING }) {
+            for (auto spin_duration : { std::chrono::microseconds(0), std::chrono::microseconds(200) }) {
+                ThreadPoolConfig config;
+                config.threads = std::max<size_t>(1, hardware_threads() / 2);
+                config.mode = mode;
+                config.spin_duration = spin_duration;
+                ThreadPool pool(config);
+
+                std::vector<double> latencies;
+                latencies.reserve(SAMPLES);
+                for (int i = 0; i < SAMPLES; ++i) {
+                    const auto submitted = std::chrono::steady_clock::now();
+                    auto started = pool.enqueue([]() { return std::chrono::steady_clock::now(); }).get();
+                    latencies.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+                    // let the workers go idle again, but not past the spin window
+                    const auto pause_until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+                    while (std::chrono::steady_clock::now() < pause_until) {
+                    }
+                }
+
+                const std::string param = "spin_us=" + std::to_string(spin_duration.count());
+                g_rows.push_back({ "wakeup_latency", mode_name(mode), pool.size(), param, "p50",
+                                   quantile(latencies, 0.5), "us" });
+                g_rows.push_back({ "wakeup_latency", mode_name(mode), pool.size(), param, "p99",
+                                   quantile(latencies, 0.99), "us" });
+            }
+        }
+    }
+
+    // latency of interactive tasks queued behind a steady stream of batch work: everything as
+    // plain tasks first, then the batch as BACKGROUND and the interactive tasks as HIGH
+    void priority_under_load() {
+        constexpr int BACKLOG = 2000;
+        constexpr int PROBES = 500;
+        constexpr int BATCH_PER_PROBE = 10;
+
+        auto busy_work = []() {
+            const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+            while (std::chrono::steady_clock::now() < until) {
+            }
+        };
+
+        for (SchedulingMode mode : ALL_MODES) {
+            for (const bool prioritized : { false, true }) {
+                ThreadPoolConfig config;
+                config.threads = hardware_threads();
+                config.mode = mode;
+                config.queue_capacity = 2 * (BACKLOG + PROBES * BATCH_PER_PROBE);
+                ThreadPool pool(config);
+
+                TaskOptions batch;
+                TaskOptions probe;
+                if (prioritized) {
+                    batch.priority = TaskPriority::BACKGROUND;
+                    probe.priority = TaskPriority::HIGH;
+                }
+                for (int i = 0; i < BACKLOG; ++i) {
+                    pool.post_with(batch, busy_work);
+                }
+
+                std::vector<double> latencies;
+                latencies.reserve(PROBES);
+                for (int i = 0; i < PROBES; ++i) {
+                    for (int j = 0; j < BATCH_PER_PROBE; ++j) {
+                        pool.post_with(batch, busy_work);
+                    }
+                    const auto submitted = std::chrono::steady_clock::now();
+                    auto started = pool.enqueue_with(probe, []() { return std::chrono::steady_clock::now(); }).get();
+                    latencies.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+                }
+                pool.wait_idle();
+
+                const std::string param = prioritized ? "lanes=high/background" : "lanes=none";
+                g_rows.push_back({ "priority_under_load", mode_name(mode), pool.size(), param, "p50",
+                                   quantile(latencies, 0.5), "us" });
+                g_rows.push_back({ "priority_under_load", mode_name(mode), pool.size(), param, "p99",
+                                   quantile(latencies, 0.99), "us" });
+            }
+        }
+    }
+
+    // empty posted tasks with and without the per-worker trace rings, the difference is
+    // what recording a span costs
+    void trace_overhead() {
+        for (SchedulingMode mode : ALL_MODES) {
+            for (const size_t capacity : { size_t{ 0 }, size_t{ 1 } << 16 }) {
+                ThreadPoolConfig config;
+                config.threads = hardware_threads();
+                config.mode = mode;
+                config.queue_capacity = TASK_COUNT;
+                config.trace_capacity = capacity;
+                ThreadPool pool(config);
+
+                const std::string param = "trace_capacity=" + std::to_string(capacity);
+                throughput("trace_overhead", mode_name(mode), pool.size(), param, TASK_COUNT, [&]() {
+                    for (int i = 0; i < TASK_COUNT; ++i) {
+                        pool.post([]() {});
+                    }
+                    pool.wait_idle();
+                });
+            }
+        }
+    }
+
+    struct Benchmark {
+        const char* name;
+        void (*run)();
+    };
+
+    constexpr Benchmark BENCHMARKS[] = {
+        { "legacy_task_storage", legacy_task_storage },
+        { "empty_task", empty_task },
+        { "enqueue_bulk", enqueue_bulk },
+        { "fan_out_fan_in", fan_out_fan_in },
+        { "contention_producer_heavy", contention_producer_heavy },
+        { "contention_consumer_heavy", contention_consumer_heavy },
+        { "recursive_spawn", recursive_spawn },
+        { "nested_wait", nested_wait },
+        { "task_memory", task_memory },
+        { "strand", strands },
+        { "future_overhead", future_overhead },
+        { "parallel_for", parallel_for_scaling },
+        { "coroutine_fan_out", coroutine_fan_out },
+        { "wakeup_latency", wakeup_latency },
+        { "priority_under_load", priority_under_load },
+        { "trace_overhead", trace_overhead },
+    };
+
+    void print_csv() {
+        for (const Row& row : g_rows) {
+            std::printf("%s,%s,%zu,%s,%s,%.3f,%s\n", row.benchmark.c_str(), row.mode.c_str(), row.threads,
+                        row.param.c_str(), row.metric.c_str(), row.value, row.unit.c_str());
+        }
+    }
+
+    // the array elements of all benchmarks so far, each but the first one after a comma
+    void print_json() {
+        static bool first = true;
+        for (const Row& row : g_rows) {
+            std::printf("%s  {\"benchmark\": \"%s\", \"mode\": \"%s\", \"threads\": %zu, \"param\": \"%s\", "
+                        "\"metric\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}",
+                        first ? "" : ",\n", row.benchmark.c_str(), row.mode.c_str(), row.threads,
+                        row.param.c_str(), row.metric.c_str(), row.value, row.unit.c_str());
+            first = false;
+        }
+    }
+
+    void print_help(const char* program) {
+        std::printf("usage: %s [--format=csv|json] [--filter=SUBSTRING] [--list]\n", program);
+        std::printf("runs the ThreadPool benchmarks whose name contains SUBSTRING, all of them by default\n");
+    }
+
+} // namespace
+
+auto main(int argc, char* argv[]) -> int {
+    bool json = false;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--format=csv") {
+            json = false;
+        } else if (arg == "--format=json") {
+            json = true;
+        } else if (arg.rfind("--filter=", 0) == 0) {
+            filter = arg.substr(std::strlen("--filter="));
+        } else if (arg == "--list") {
+            for (const Benchmark& benchmark : BENCHMARKS) {
+                std::printf("%s\n", benchmark.name);
+            }
+            return 0;
+        } else {
+            print_help(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // rows go out as each benchmark finishes, so a run that dies halfway still leaves the
+    // results so far (a JSON array then just lacks its closing bracket)
+    std::printf(json ? "[\n" : "benchmark,mode,threads,param,metric,value,unit\n");
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        if (std::string(benchmark.name).find(filter) != std::string::npos) {
+            // progress goes to stderr so stdout stays machine-readable
+            std::fprintf(stderr, "running %s\n", benchmark.name);
+            benchmark.run();
+            if (json) {
+                print_json();
+            } else {
+                print_csv();
+            }
+            g_rows.clear();
+            std::fflush(stdout);
+        }
+    }
+    if (json) {
+        std::printf("\n]\n");
+    }
+    return 0;
+}
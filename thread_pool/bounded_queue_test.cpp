@@ -0,0 +1,124 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+    constexpr size_t CAPACITY = 8;
+    constexpr int SUBMITTERS = 4;
+
+    // keeps the only worker busy, so nothing leaves the queue while it is filled
+    class Gate {
+    public:
+        void enter() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _entered = true;
+            _condition.notify_all();
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _open;
+                });
+        }
+
+        void wait_entered() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _entered;
+                });
+        }
+
+        void open() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _open = true;
+            _condition.notify_all();
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _entered = false;
+        bool _open = false;
+    };
+
+    auto make_pool() -> ThreadPoolConfig {
+        ThreadPoolConfig config;
+        config.threads = 1;
+        config.mode = SchedulingMode::BOUNDED_QUEUE;
+        config.queue_capacity = CAPACITY;
+        return config;
+    }
+
+} // namespace
+
+int main() {
+    int failures = 0;
+
+    // submitters racing for the last slots never get more than the capacity in
+    {
+        ThreadPool pool(make_pool());
+        Gate gate;
+        pool.post([&gate]() { gate.enter(); });
+        gate.wait_entered();
+
+        std::atomic<int> accepted{ 0 };
+        std::atomic<int> ran{ 0 };
+        std::vector<std::thread> submitters;
+        for (int i = 0; i < SUBMITTERS; ++i) {
+            submitters.emplace_back(
+                [&pool, &accepted, &ran]() {
+                    while (pool.try_post([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); })) {
+                        accepted.fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+        }
+        for (std::thread& submitter : submitters) {
+            submitter.join();
+        }
+        const bool refused = !pool.try_enqueue([]() {}).has_value();
+        gate.open();
+        pool.wait_idle();
+
+        if (accepted != static_cast<int>(CAPACITY) || !refused || ran != accepted) {
+            std::printf("outside submitters: %d accepted, %d ran, try_enqueue %s on a full queue\n", accepted.load(),
+                        ran.load(), refused ? "refused" : "accepted");
+            ++failures;
+        }
+    }
+
+    // a worker's own tasks count against the same capacity, and once it is reached the
+    // worker runs what it posts itself instead of waiting for a slot it would have to free
+    {
+        ThreadPool pool(make_pool());
+        int accepted = 0;
+        bool ran_inline = false;
+        std::atomic<int> ran{ 0 };
+        pool.post(
+            [&pool, &accepted, &ran_inline, &ran]() {
+                while (pool.try_post([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); })) {
+                    ++accepted;
+                }
+                const std::thread::id worker = std::this_thread::get_id();
+                pool.post([&ran_inline, worker]() { ran_inline = std::this_thread::get_id() == worker; });
+            });
+        pool.wait_idle();
+
+        if (accepted != static_cast<int>(CAPACITY) || !ran_inline || ran != accepted) {
+            std::printf("worker submitter: %d accepted, %d ran, post on a full queue %s\n", accepted, ran.load(),
+                        ran_inline ? "ran inline" : "didn't run inline");
+            ++failures;
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("bounded queue capacity: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+template <typename T = void>
+class Task;
+
+namespace coro_detail {
+
+    class PromiseBase {
+    public:
+        // resumes whoever awaited the task, or nothing if it was never awaited
+        struct FinalAwaiter {
+            [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+
+            template <typename Promise>
+            auto await_suspend(std::coroutine_handle<Promise> handle) const noexcept -> std::coroutine_handle<> {
+                std::coroutine_handle<> continuation = handle.promise()._continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        // tasks are lazy, nothing runs until they are awaited
+        auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+        auto final_suspend() const noexcept -> FinalAwaiter { return {}; }
+
+        void unhandled_exception() noexcept { _error = std::current_exception(); }
+
+        void set_continuation(std::coroutine_handle<> continuation) noexcept { _continuation = continuation; }
+
+    protected:
+        void rethrow_if_error() const {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+        }
+
+    private:
+        std::coroutine_handle<> _continuation;
+        std::exception_ptr _error;
+    };
+
+    template <typename T>
+    class Promise : public PromiseBase {
+    public:
+        auto get_return_object() noexcept -> Task<T>;
+
+        template <typename Value>
+        void return_value(Value&& value) {
+            _value.emplace(std::forward<Value>(value));
+        }
+
+        auto result() -> T {
+            rethrow_if_error();
+            return std::move(*_value);
+        }
+
+    private:
+        std::optional<T> _value;
+    };
+
+    template <>
+    class Promise<void> : public PromiseBase {
+    public:
+        auto get_return_object() noexcept -> Task<void>;
+
+        void return_void() const noexcept {}
+
+        void result() const { rethrow_if_error(); }
+    };
+
+    // eager, self-destroying coroutine used to start a Task from ordinary code
+    struct DetachedTask {
+        struct promise_type {
+            auto get_return_object() const noexcept -> DetachedTask { return {}; }
+            auto initial_suspend() const noexcept -> std::suspend_never { return {}; }
+            auto final_suspend() const noexcept -> std::suspend_never { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    // one-shot flag for sync_wait. notify happens under the lock because the
+    // waiter destroys the event as soon as it sees the flag
+    class Event {
+    public:
+        void set() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _set = true;
+            _condition.notify_all();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _set;
+                });
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _set = false;
+    };
+
+} // namespace coro_detail
+
+// lazily started coroutine returning T. co_await it from another coroutine, or
+// sync_wait() it from ordinary code; co_await pool.schedule() inside it moves it to the pool
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = coro_detail::Promise<T>;
+
+    Task() noexcept = default;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+        : _handle(handle) {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task(Task&& other) noexcept
+        : _handle(std::exchange(other._handle, nullptr)) {}
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    // the child is started and finished with symmetric transfer, no trip through the pool.
+    // awaiting an empty (default-constructed or moved-from) task throws std::logic_error
+    auto operator co_await() {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            [[nodiscard]] auto await_ready() const noexcept -> bool { return handle.done(); }
+
+            auto await_suspend(std::coroutine_handle<> awaiting) noexcept -> std::coroutine_handle<> {
+                handle.promise().set_continuation(awaiting);
+                return handle;
+            }
+
+            auto await_resume() -> T { return handle.promise().result(); }
+        };
+        if (!_handle) {
+            throw std::logic_error("co_await on an empty Task");
+        }
+        return Awaiter{ _handle };
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template <typename T>
+inline auto coro_detail::Promise<T>::get_return_object() noexcept -> Task<T> {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline auto coro_detail::Promise<void>::get_return_object() noexcept -> Task<void> {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// runs the task to completion on the calling thread and whatever pools it hops onto
+template <typename T>
+auto sync_wait(Task<T> task) -> T {
+    coro_detail::Event done;
+    std::exception_ptr error;
+
+    if constexpr (std::is_void_v<T>) {
+        [](Task<void>& task, coro_detail::Event& done, std::exception_ptr& error) -> coro_detail::DetachedTask {
+            try {
+                co_await task;
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done.set();
+        }(task, done, error);
+
+        done.wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    } else {
+        std::optional<T> result;
+        [](Task<T>& task, coro_detail::Event& done, std::optional<T>& result, std::exception_ptr& error) -> coro_detail::DetachedTask {
+            try {
+                result.emplace(co_await task);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done.set();
+        }(task, done, result, error);
+
+        done.wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*result);
+    }
+}
+
+namespace coro_detail {
+
+    // starts every child right away and resumes the parent when the last one finishes
+    template <typename T>
+    class WhenAllAwaiter {
+    public:
+        using results_type = std::conditional_t<std::is_void_v<T>, std::monostate, std::vector<std::optional<T>>>;
+
+        explicit WhenAllAwaiter(std::vector<Task<T>>& tasks)
+            : _tasks(tasks),
+              _remaining(tasks.size() + 1) {
+            if constexpr (!std::is_void_v<T>) {
+                _results.resize(tasks.size());
+            }
+        }
+
+        [[nodiscard]] auto await_ready() const noexcept -> bool { return _tasks.empty(); }
+
+        auto await_suspend(std::coroutine_handle<> parent) -> bool {
+            _parent = parent;
+            for (size_t i = 0; i < _tasks.size(); ++i) {
+                start(i);
+            }
+            // the extra count is ours: if every child already finished, don't suspend at all
+            return _remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        auto await_resume() {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            if constexpr (!std::is_void_v<T>) {
+                std::vector<T> values;
+                values.reserve(_results.size());
+                for (std::optional<T>& result : _results) {
+                    values.push_back(std::move(*result));
+                }
+                return values;
+            }
+        }
+
+    private:
+        auto start(size_t index) -> DetachedTask {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    co_await _tasks[index];
+                } else {
+                    _results[index].emplace(co_await _tasks[index]);
+                }
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(_error_mutex);
+                if (!_error) {
+                    _error = std::current_exception();
+                }
+            }
+            if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                _parent.resume();
+            }
+        }
+
+        std::vector<Task<T>>& _tasks;
+        results_type _results;
+        std::atomic<size_t> _remaining;
+        std::coroutine_handle<> _parent;
+        std::mutex _error_mutex;
+        std::exception_ptr _error;
+    };
+
+} // namespace coro_detail
+
+// runs every task concurrently and collects the results in order.
+// the first exception is rethrown once all tasks are done
+template <typename T>
+auto when_all(std::vector<Task<T>> tasks) -> Task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> {
+    co_return co_await coro_detail::WhenAllAwaiter<T>(tasks);
+}
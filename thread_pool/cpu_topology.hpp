@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}, the format of the /sys cpulist files
+inline auto parse_cpu_list(const std::string& list) -> std::vector<int> {
+    std::vector<int> cpus;
+    std::istringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // skip anything that isn't a number, the list is only a placement hint
+        }
+    }
+    return cpus;
+}
+
+// NUMA nodes that have CPUs, and their CPUs. without /sys (or off Linux) everything is one node
+struct CpuTopology {
+    // the kernel's number of each node, ids[i] is /sys/devices/system/node/node<ids[i]>.
+    // memory-only nodes are left out, so the numbers can have gaps
+    std::vector<int> ids;
+    std::vector<std::vector<int>> nodes;
+
+    static auto detect() -> CpuTopology {
+        CpuTopology topology;
+#ifdef __linux__
+        std::string online;
+        if (std::ifstream file("/sys/devices/system/node/online"); file) {
+            std::getline(file, online);
+        }
+        // the online list uses the cpulist format, and may skip numbers
+        for (int node : parse_cpu_list(online)) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) {
+                continue;
+            }
+            std::string list;
+            std::getline(file, list);
+            auto cpus = parse_cpu_list(list);
+            // memory-only nodes have no CPUs to run workers on
+            if (!cpus.empty()) {
+                topology.ids.push_back(node);
+                topology.nodes.push_back(std::move(cpus));
+            }
+        }
+#endif
+        if (topology.nodes.empty()) {
+            std::vector<int> cpus;
+            const unsigned count = std::max(1U, std::thread::hardware_concurrency());
+            for (unsigned cpu = 0; cpu < count; ++cpu) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+            topology.ids.push_back(0);
+            topology.nodes.push_back(std::move(cpus));
+        }
+        return topology;
+    }
+
+    // the position in nodes of the node holding cpu, 0 for CPUs we don't know about
+    [[nodiscard]] auto node_of_cpu(int cpu) const -> size_t {
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            for (int candidate : nodes[node]) {
+                if (candidate == cpu) {
+                    return node;
+                }
+            }
+        }
+        return 0;
+    }
+};
+
+// restricts the calling thread to the given CPUs, false if the OS refused or isn't Linux
+inline auto pin_current_thread(const std::vector<int>& cpus) -> bool {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
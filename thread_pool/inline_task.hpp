@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "instrumentation.hpp"
+
+// move-only replacement for std::function<void()>.
+// closures up to INLINE_SIZE bytes live inside the object, larger ones go to the heap,
+// or to the memory_resource passed with std::allocator_arg
+class InlineTask {
+public:
+    static constexpr size_t INLINE_SIZE = 64 - sizeof(void*);
+    static constexpr size_t INLINE_ALIGN = alignof(std::max_align_t);
+
+    InlineTask() noexcept = default;
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineTask>>>
+    InlineTask(F&& f) { // NOLINT(google-explicit-constructor)
+        using callable_type = std::decay_t<F>;
+        if constexpr (fits_inline<callable_type>()) {
+            ::new (static_cast<void*>(_storage)) callable_type(std::forward<F>(f));
+            _vtable = &INLINE_VTABLE<callable_type>;
+        } else {
+            ::new (static_cast<void*>(_storage)) callable_type*(new callable_type(std::forward<F>(f)));
+            _vtable = &HEAP_VTABLE<callable_type>;
+        }
+    }
+
+    // like the constructor above, but a closure too large for the buffer is allocated from
+    // resource. a null resource means the heap
+    template <typename F>
+    InlineTask(std::allocator_arg_t, std::pmr::memory_resource* resource, F&& f) {
+        using callable_type = std::decay_t<F>;
+        if constexpr (fits_inline<callable_type>()) {
+            ::new (static_cast<void*>(_storage)) callable_type(std::forward<F>(f));
+            _vtable = &INLINE_VTABLE<callable_type>;
+        } else if (resource == nullptr) {
+            ::new (static_cast<void*>(_storage)) callable_type*(new callable_type(std::forward<F>(f)));
+            _vtable = &HEAP_VTABLE<callable_type>;
+        } else {
+            using box_type = ResourceBox<callable_type>;
+            void* memory = resource->allocate(sizeof(box_type), alignof(box_type));
+            try {
+                ::new (static_cast<void*>(_storage)) box_type*(::new (memory) box_type{ resource, std::forward<F>(f) });
+            } catch (...) {
+                resource->deallocate(memory, sizeof(box_type), alignof(box_type));
+                throw;
+            }
+            _vtable = &RESOURCE_VTABLE<callable_type>;
+        }
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    InlineTask(InlineTask&& other) noexcept
+        : _vtable(other._vtable) {
+#if THREAD_POOL_INSTRUMENTATION
+        _queued_at = other._queued_at;
+#endif
+        if (_vtable != nullptr) {
+            _vtable->move(_storage, other._storage);
+            other._vtable = nullptr;
+        }
+    }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            _vtable = other._vtable;
+#if THREAD_POOL_INSTRUMENTATION
+            _queued_at = other._queued_at;
+#endif
+            if (_vtable != nullptr) {
+                _vtable->move(_storage, other._storage);
+                other._vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~InlineTask() { reset(); }
+
+    void operator()() { _vtable->invoke(_storage); }
+
+    explicit operator bool() const noexcept { return _vtable != nullptr; }
+
+#if THREAD_POOL_INSTRUMENTATION
+    // set by ThreadPool when the task is queued, for the queue-wait histogram
+    void set_queued_at(std::chrono::steady_clock::time_point time) noexcept { _queued_at = time; }
+    [[nodiscard]] auto queued_at() const noexcept -> std::chrono::steady_clock::time_point { return _queued_at; }
+#endif
+
+    // true when F would be stored without a heap allocation
+    template <typename F>
+    static constexpr auto fits_inline() -> bool {
+        return sizeof(F) <= INLINE_SIZE
+               && alignof(F) <= INLINE_ALIGN
+               && std::is_nothrow_move_constructible_v<F>;
+    }
+
+private:
+    struct VTable {
+        void (*invoke)(void* storage);
+        // move-constructs into dst and destroys src
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename F>
+    static constexpr VTable INLINE_VTABLE{
+        [](void* storage) { std::invoke(*static_cast<F*>(storage)); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [](void* storage) noexcept { static_cast<F*>(storage)->~F(); }
+    };
+
+    template <typename F>
+    static constexpr VTable HEAP_VTABLE{
+        [](void* storage) { std::invoke(**static_cast<F**>(storage)); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) F*(*static_cast<F**>(src));
+        },
+        [](void* storage) noexcept { delete *static_cast<F**>(storage); }
+    };
+
+    // a heap closure that remembers where it came from
+    template <typename F>
+    struct ResourceBox {
+        std::pmr::memory_resource* resource;
+        F f;
+    };
+
+    template <typename F>
+    static constexpr VTable RESOURCE_VTABLE{
+        [](void* storage) { std::invoke((*static_cast<ResourceBox<F>**>(storage))->f); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) ResourceBox<F>*(*static_cast<ResourceBox<F>**>(src));
+        },
+        [](void* storage) noexcept {
+            ResourceBox<F>* box = *static_cast<ResourceBox<F>**>(storage);
+            std::pmr::memory_resource* resource = box->resource;
+            box->~ResourceBox<F>();
+            resource->deallocate(box, sizeof(ResourceBox<F>), alignof(ResourceBox<F>));
+        }
+    };
+
+    void reset() noexcept {
+        if (_vtable != nullptr) {
+            _vtable->destroy(_storage);
+            _vtable = nullptr;
+        }
+    }
+
+    alignas(INLINE_ALIGN) unsigned char _storage[INLINE_SIZE];
+    const VTable* _vtable = nullptr;
+#if THREAD_POOL_INSTRUMENTATION
+    std::chrono::steady_clock::time_point _queued_at;
+#endif
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// build with THREAD_POOL_INSTRUMENTATION=1 (cmake -DTHREAD_POOL_INSTRUMENTATION=ON) to have
+// ThreadPool record the statistics in pool_stats.hpp. off by default: the hooks compile to
+// nothing and ThreadPool::stats() comes back empty
+#ifndef THREAD_POOL_INSTRUMENTATION
+#define THREAD_POOL_INSTRUMENTATION 0
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// bounded lock-free multi-producer/multi-consumer ring buffer.
+// every cell carries a sequence number that tells producers and consumers
+// whose turn it is, so a push or pop is one CAS on the shared cursor
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity)
+        : _mask(round_up_to_power_of_two(capacity) - 1),
+          _cells(std::make_unique<Cell[]>(_mask + 1)) {
+        for (size_t i = 0; i <= _mask; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+    MpmcQueue(MpmcQueue&&) = delete;
+    MpmcQueue& operator=(MpmcQueue&&) = delete;
+
+    ~MpmcQueue() {
+        T value;
+        while (try_pop(value)) {
+        }
+    }
+
+    // moves from value only on success
+    auto try_push(T& value) -> bool {
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = _cells[pos & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ::new (static_cast<void*>(cell.storage)) T(std::move(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // the consumer of the previous lap hasn't freed this cell: full
+                return false;
+            } else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    auto try_pop(T& value) -> bool {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = _cells[pos & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* stored = std::launder(reinterpret_cast<T*>(cell.storage));
+                    value = std::move(*stored);
+                    stored->~T();
+                    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // nothing published in this cell yet: empty
+                return false;
+            } else {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] auto capacity() const -> size_t { return _mask + 1; }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static auto round_up_to_power_of_two(size_t value) -> size_t {
+        if (value == 0) {
+            throw std::invalid_argument("MpmcQueue capacity must be positive");
+        }
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t _mask;
+    const std::unique_ptr<Cell[]> _cells;
+
+    // producers and consumers hammer different cursors, keep them on separate lines
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _enqueue_pos{ 0 };
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _dequeue_pos{ 0 };
+};
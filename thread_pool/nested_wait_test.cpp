@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <initializer_list>
+
+#include "task_future.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+    // a binary tree of tasks, each waiting for both of its subtrees
+    auto count_leaves(ThreadPool& pool, int depth) -> long {
+        if (depth == 0) {
+            return 1;
+        }
+        TaskFuture<long> left = spawn(pool, [&pool, depth]() { return count_leaves(pool, depth - 1); });
+        TaskFuture<long> right = spawn(pool, [&pool, depth]() { return count_leaves(pool, depth - 1); });
+        return left.get() + right.get();
+    }
+
+    // a chain of tasks, deeper than ThreadPool::MAX_HELP_DEPTH in the last check so a
+    // worker has to hand its helping over to a stand-in thread
+    auto count_chain(ThreadPool& pool, int depth) -> int {
+        if (depth == 0) {
+            return 0;
+        }
+        return spawn(pool, [&pool, depth]() { return count_chain(pool, depth - 1); }).get() + 1;
+    }
+
+} // namespace
+
+int main() {
+    constexpr int TREE_DEPTH = 20;
+    constexpr int CHAIN_DEPTH = 200;
+
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        for (const size_t threads : { 1, 4 }) {
+            ThreadPoolConfig config;
+            config.threads = threads;
+            config.mode = mode;
+            config.queue_capacity = 64;
+            ThreadPool pool(config);
+
+            const long leaves = spawn(pool, [&pool]() { return count_leaves(pool, TREE_DEPTH); }).get();
+            if (leaves != 1L << TREE_DEPTH) {
+                std::printf("mode %d, %zu threads: %ld leaves, expected %ld\n", static_cast<int>(mode), threads,
+                            leaves, 1L << TREE_DEPTH);
+                ++failures;
+            }
+
+            // one worker can't block for each level, it needs helping to get through
+            if (threads > 1) {
+                continue;
+            }
+            const int links = count_chain(pool, TREE_DEPTH);
+            if (links != TREE_DEPTH) {
+                std::printf("mode %d: chain of %d, expected %d\n", static_cast<int>(mode), links, TREE_DEPTH);
+                ++failures;
+            }
+        }
+
+        // deeper than MAX_HELP_DEPTH, still on a single worker
+        ThreadPoolConfig config;
+        config.threads = 1;
+        config.mode = mode;
+        config.queue_capacity = 64;
+        ThreadPool pool(config);
+        const int links = spawn(pool, [&pool]() { return count_chain(pool, CHAIN_DEPTH); }).get();
+        if (links != CHAIN_DEPTH) {
+            std::printf("mode %d: chain of %d, expected %d\n", static_cast<int>(mode), links, CHAIN_DEPTH);
+            ++failures;
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("nested waits: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
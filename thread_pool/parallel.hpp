@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// how the parallel algorithms cut [first, last) into chunks
+enum class Partition : std::uint8_t {
+    // fixed chunks of `grain` elements, by default one chunk per participating thread
+    STATIC,
+    // chunks shrink as the range runs out, so slow or late threads still balance
+    ADAPTIVE
+};
+
+struct ParallelOptions {
+    Partition partition = Partition::ADAPTIVE;
+    // chunk size for STATIC, smallest chunk for ADAPTIVE, 0 picks one from the range size
+    size_t grain = 0;
+};
+
+namespace parallel_detail {
+
+    // number of elements in [first, last) for both index and iterator ranges
+    template <typename It>
+    auto distance(It first, It last) -> size_t {
+        if constexpr (std::is_integral_v<It>) {
+            return last > first ? static_cast<size_t>(last - first) : 0;
+        } else {
+            static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                            typename std::iterator_traits<It>::iterator_category>,
+                          "parallel algorithms need random access iterators");
+            const auto count = std::distance(first, last);
+            return count > 0 ? static_cast<size_t>(count) : 0;
+        }
+    }
+
+    // the index itself for index ranges, the element for iterator ranges
+    template <typename It>
+    auto element(It first, size_t offset) -> decltype(auto) {
+        if constexpr (std::is_integral_v<It>) {
+            return static_cast<It>(first + static_cast<It>(offset));
+        } else {
+            return first[static_cast<typename std::iterator_traits<It>::difference_type>(offset)];
+        }
+    }
+
+    // shared by the caller and the helper tasks. helpers may start after the caller
+    // returned, so they only touch `body` after claiming a chunk, which can't happen by then
+    template <typename Body>
+    class ChunkState {
+    public:
+        ChunkState(size_t count, size_t participants, const ParallelOptions& options, Body& body)
+            : _count(count),
+              _participants(participants),
+              _partition(options.partition),
+              _grain(pick_grain(count, participants, options)),
+              _body(&body) {}
+
+        [[nodiscard]] auto chunk_count() const -> size_t {
+            if (_partition == Partition::STATIC) {
+                return (_count + _grain - 1) / _grain;
+            }
+            return _count;
+        }
+
+        // claims and runs chunks until the range is exhausted
+        void work() {
+            size_t begin = 0;
+            size_t end = 0;
+            while (claim(begin, end)) {
+                if (!_failed.load(std::memory_order_relaxed)) {
+                    try {
+                        (*_body)(begin, end);
+                    } catch (...) {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        if (!_error) {
+                            _error = std::current_exception();
+                        }
+                        _failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                finish(end - begin);
+            }
+        }
+
+        // waits for chunks still running on helpers, then rethrows the first error
+        void wait() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done_condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _done.load(std::memory_order_acquire) == _count;
+                });
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+        }
+
+    private:
+        static auto pick_grain(size_t count, size_t participants, const ParallelOptions& options) -> size_t {
+            if (options.grain > 0) {
+                return options.grain;
+            }
+            if (options.partition == Partition::STATIC) {
+                return std::max<size_t>(1, (count + participants - 1) / participants);
+            }
+            return std::max<size_t>(1, count / (participants * 64));
+        }
+
+        auto claim(size_t& begin, size_t& end) -> bool {
+            size_t current = _cursor.load(std::memory_order_relaxed);
+            while (current < _count) {
+                size_t size = _grain;
+                if (_partition == Partition::ADAPTIVE) {
+                    // guided: take a share of what is left, never less than the grain
+                    size = std::max(_grain, (_count - current) / (2 * _participants));
+                }
+                const size_t next = std::min(_count, current + size);
+                if (_cursor.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+                    begin = current;
+                    end = next;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void finish(size_t elements) {
+            if (_done.fetch_add(elements, std::memory_order_acq_rel) + elements == _count) {
+                { std::unique_lock<std::mutex> lock(_mutex); }
+                _done_condition.notify_all();
+            }
+        }
+
+        const size_t _count;
+        const size_t _participants;
+        const Partition _partition;
+        const size_t _grain;
+        Body* const _body;
+
+        std::atomic<size_t> _cursor{ 0 };
+        std::atomic<size_t> _done{ 0 };
+        std::atomic<bool> _failed{ false };
+
+        std::mutex _mutex;
+        std::condition_variable _done_condition;
+        std::exception_ptr _error;
+    };
+
+    // runs body(begin, end) over chunks of [0, count) on the pool and the calling thread
+    template <typename Body>
+    void run_chunks(ThreadPool& pool, size_t count, const ParallelOptions& options, Body& body) {
+        if (count == 0) {
+            return;
+        }
+
+        const size_t participants = pool.size() + 1;
+        auto state = std::make_shared<ChunkState<Body>>(count, participants, options, body);
+
+        // one helper per worker at most, and none for chunks the caller will take itself.
+        // a full bounded pool just means the caller does more of the work
+        const size_t helpers = std::min(pool.size(), state->chunk_count() - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            if (!pool.try_post([state]() { state->work(); })) {
+                break;
+            }
+        }
+
+        state->work();
+        state->wait();
+    }
+
+} // namespace parallel_detail
+
+// runs f(i) for every index in [first, last), or f(*it) for every element of an iterator range
+template <typename It, typename F>
+void parallel_for(ThreadPool& pool, It first, It last, F&& f, const ParallelOptions& options = {}) {
+    auto body = [&](size_t begin, size_t end) {
+        for (size_t offset = begin; offset < end; ++offset) {
+            f(parallel_detail::element(first, offset));
+        }
+    };
+    parallel_detail::run_chunks(pool, parallel_detail::distance(first, last), options, body);
+}
+
+// writes f(element) to d_first[offset] for every element, returns the end of the output
+template <typename It, typename OutIt, typename F>
+auto parallel_transform(ThreadPool& pool, It first, It last, OutIt d_first, F&& f, const ParallelOptions& options = {})
+    -> OutIt {
+    const size_t count = parallel_detail::distance(first, last);
+    auto body = [&](size_t begin, size_t end) {
+        for (size_t offset = begin; offset < end; ++offset) {
+            d_first[static_cast<typename std::iterator_traits<OutIt>::difference_type>(offset)] =
+                f(parallel_detail::element(first, offset));
+        }
+    };
+    parallel_detail::run_chunks(pool, count, options, body);
+    return d_first + static_cast<typename std::iterator_traits<OutIt>::difference_type>(count);
+}
+
+// folds every chunk with accumulate(T, element) starting from identity, then folds the
+// chunk results with combine(T, T) in range order, so combine only needs to be associative
+template <typename It, typename T, typename Accumulate, typename Combine>
+auto parallel_reduce(ThreadPool& pool,
+                     It first,
+                     It last,
+                     T identity,
+                     Accumulate&& accumulate,
+                     Combine&& combine,
+                     const ParallelOptions& options = {}) -> T {
+    std::mutex partials_mutex;
+    std::vector<std::pair<size_t, T>> partials;
+
+    auto body = [&](size_t begin, size_t end) {
+        T partial = identity;
+        for (size_t offset = begin; offset < end; ++offset) {
+            partial = accumulate(std::move(partial), parallel_detail::element(first, offset));
+        }
+        std::unique_lock<std::mutex> lock(partials_mutex);
+        partials.emplace_back(begin, std::move(partial));
+    };
+    parallel_detail::run_chunks(pool, parallel_detail::distance(first, last), options, body);
+
+    std::sort(partials.begin(), partials.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    T result = std::move(identity);
+    for (auto& partial : partials) {
+        result = combine(std::move(result), std::move(partial.second));
+    }
+    return result;
+}
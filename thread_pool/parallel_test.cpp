@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "parallel.hpp"
+#include "task_future.hpp"
+#include "task_graph.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+    constexpr size_t ELEMENTS = 10000;
+
+    // every node runs after all of its dependencies, and a failing node skips its dependents
+    auto check_graph(ThreadPool& pool) -> bool {
+        constexpr size_t LAYERS = 20;
+        constexpr size_t WIDTH = 8;
+
+        TaskGraph graph;
+        std::atomic<size_t> clock{ 0 };
+        auto finished = std::make_unique<std::atomic<size_t>[]>(LAYERS * WIDTH);
+        std::atomic<int> too_early{ 0 };
+        std::vector<TaskGraph::NodeId> previous;
+        for (size_t layer = 0; layer < LAYERS; ++layer) {
+            std::vector<TaskGraph::NodeId> current;
+            for (size_t i = 0; i < WIDTH; ++i) {
+                // each node waits for its two neighbours in the layer above
+                std::vector<TaskGraph::NodeId> dependencies;
+                if (!previous.empty()) {
+                    dependencies = { previous[i], previous[(i + 1) % WIDTH] };
+                }
+                current.push_back(graph.add(
+                    [&clock, &finished, &too_early, dependencies, id = layer * WIDTH + i]() {
+                        for (const TaskGraph::NodeId dependency : dependencies) {
+                            if (finished[dependency] == 0) {
+                                too_early.fetch_add(1);
+                            }
+                        }
+                        finished[id] = clock.fetch_add(1) + 1;
+                    },
+                    dependencies));
+            }
+            previous = std::move(current);
+        }
+        graph.run(pool).get();
+        bool ok = too_early == 0 && clock == LAYERS * WIDTH;
+
+        bool skipped_ran = false;
+        TaskGraph failing;
+        const TaskGraph::NodeId root = failing.add([]() { throw std::runtime_error("node failed"); });
+        failing.add([&skipped_ran]() { skipped_ran = true; }, { root });
+        try {
+            failing.run(pool).get();
+            ok = false;
+        } catch (const std::runtime_error&) {
+        }
+        return ok && !skipped_ran;
+    }
+
+} // namespace
+
+int main() {
+    std::vector<int> values(ELEMENTS);
+    std::iota(values.begin(), values.end(), 0);
+    std::string expected;
+    for (const int value : values) {
+        expected += static_cast<char>('a' + value % 26);
+    }
+
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        ThreadPoolConfig config;
+        config.threads = 4;
+        config.mode = mode;
+        config.queue_capacity = 64;
+        ThreadPool pool(config);
+
+        for (const Partition partition : { Partition::STATIC, Partition::ADAPTIVE }) {
+            for (const size_t grain : { 0, 7 }) {
+                const ParallelOptions options{ partition, grain };
+
+                // concatenation isn't commutative, so the chunks have to be combined in range order
+                const std::string joined = parallel_reduce(
+                    pool, values.begin(), values.end(), std::string(),
+                    [](std::string text, int value) {
+                        text += static_cast<char>('a' + value % 26);
+                        return text;
+                    },
+                    [](std::string lhs, const std::string& rhs) { return lhs + rhs; }, options);
+
+                // every index exactly once, also from inside a task of the same pool
+                auto visits = std::make_unique<std::atomic<int>[]>(ELEMENTS);
+                spawn(pool,
+                      [&pool, &visits, options]() {
+                          parallel_for(pool, size_t{ 0 }, ELEMENTS, [&visits](size_t i) { visits[i].fetch_add(1); },
+                                       options);
+                      })
+                    .get();
+                size_t visited_once = 0;
+                for (size_t i = 0; i < ELEMENTS; ++i) {
+                    visited_once += visits[i] == 1 ? 1 : 0;
+                }
+
+                if (joined != expected || visited_once != ELEMENTS) {
+                    std::printf("mode %d, partition %d, grain %zu: reduce %s, %zu of %zu visited once\n",
+                                static_cast<int>(mode), static_cast<int>(partition), grain,
+                                joined == expected ? "in order" : "out of order", visited_once, ELEMENTS);
+                    ++failures;
+                }
+            }
+        }
+
+        if (!check_graph(pool)) {
+            std::printf("mode %d: task graph ran a node before its dependencies or past a failure\n",
+                        static_cast<int>(mode));
+            ++failures;
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("parallel algorithms: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+// TaskPriority classes, the per-class histograms are indexed by TaskPriority
+inline constexpr size_t PRIORITY_CLASSES = 3;
+
+// latency histogram with power-of-two buckets: bucket 0 holds 0ns, bucket i holds [2^(i-1), 2^i) ns
+struct HistogramSnapshot {
+    static constexpr size_t BUCKETS = 48;
+
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    std::chrono::nanoseconds max{ 0 };
+
+    static auto bucket_of(std::chrono::nanoseconds value) -> size_t {
+        const auto ns = static_cast<uint64_t>(std::max<int64_t>(0, value.count()));
+        return std::min<size_t>(BUCKETS - 1, std::bit_width(ns));
+    }
+
+    // upper bound of the bucket holding the p-th quantile, p in [0, 1], capped at max
+    [[nodiscard]] auto percentile(double p) const -> std::chrono::nanoseconds {
+        if (total == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        const auto rank = static_cast<uint64_t>(std::clamp(p, 0.0, 1.0) * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const auto upper = i == 0 ? 0 : static_cast<int64_t>((uint64_t{ 1 } << i) - 1);
+                return std::min(max, std::chrono::nanoseconds(upper));
+            }
+        }
+        return max;
+    }
+
+    void merge(const HistogramSnapshot& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+};
+
+struct WorkerStatsSnapshot {
+    uint64_t tasks_run = 0;
+    // time spent inside tasks, and everything else since the worker started
+    std::chrono::nanoseconds busy{ 0 };
+    std::chrono::nanoseconds idle{ 0 };
+    // tasks taken from another worker's or node's queue
+    uint64_t steals = 0;
+    // tasks the worker submitted to a full BOUNDED_QUEUE ring and ran itself, see ThreadPool::enqueue
+    uint64_t inline_runs = 0;
+};
+
+struct ThreadPoolStats {
+    // false when the pool was built without THREAD_POOL_INSTRUMENTATION
+    bool enabled = false;
+    // one entry per worker slot, retired slots keep their totals
+    std::vector<WorkerStatsSnapshot> workers;
+    // from queueing a task to a worker picking it up
+    HistogramSnapshot queue_wait;
+    // queue_wait split up by TaskPriority, to check that HIGH stays fast under BACKGROUND load
+    std::array<HistogramSnapshot, PRIORITY_CLASSES> queue_wait_by_priority;
+    HistogramSnapshot execution;
+    size_t queue_depth_high_water = 0;
+};
+
+namespace stats_detail {
+
+    // every counter has a single writer, its worker, so updates are plain relaxed
+    // load/store pairs and readers may see a snapshot that is slightly behind
+    inline void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    class Histogram {
+    public:
+        void record(std::chrono::nanoseconds value) {
+            bump(_counts[HistogramSnapshot::bucket_of(value)], 1);
+            const auto ns = static_cast<uint64_t>(std::max<int64_t>(0, value.count()));
+            if (ns > _max.load(std::memory_order_relaxed)) {
+                _max.store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        void add_to(HistogramSnapshot& snapshot) const {
+            HistogramSnapshot mine;
+            for (size_t i = 0; i < HistogramSnapshot::BUCKETS; ++i) {
+                mine.counts[i] = _counts[i].load(std::memory_order_relaxed);
+                mine.total += mine.counts[i];
+            }
+            mine.max = std::chrono::nanoseconds(_max.load(std::memory_order_relaxed));
+            snapshot.merge(mine);
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKETS> _counts{};
+        std::atomic<uint64_t> _max{ 0 };
+    };
+
+    struct alignas(64) WorkerCounters {
+        std::atomic<uint64_t> tasks_run{ 0 };
+        std::atomic<uint64_t> busy_ns{ 0 };
+        std::atomic<uint64_t> idle_ns{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+        std::atomic<uint64_t> inline_runs{ 0 };
+        Histogram queue_wait;
+        std::array<Histogram, PRIORITY_CLASSES> queue_wait_by_priority;
+        Histogram execution;
+        // when the worker last finished a task, only touched by the worker
+        std::chrono::steady_clock::time_point last_end;
+
+        [[nodiscard]] auto snapshot() const -> WorkerStatsSnapshot {
+            return WorkerStatsSnapshot{
+                tasks_run.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds(busy_ns.load(std::memory_order_relaxed)),
+                std::chrono::nanoseconds(idle_ns.load(std::memory_order_relaxed)),
+                steals.load(std::memory_order_relaxed),
+                inline_runs.load(std::memory_order_relaxed)
+            };
+        }
+    };
+
+} // namespace stats_detail
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+#include "inline_task.hpp"
+
+// scheduling class of a task, see ThreadPool::post_with and ThreadPool::enqueue_with
+enum class TaskPriority : std::uint8_t {
+    // interactive work, runs ahead of everything else that is queued
+    HIGH,
+    // what post and enqueue submit
+    NORMAL,
+    // batch work, runs when nothing else is queued, or once it waited for starvation_limit
+    BACKGROUND
+};
+
+struct TaskOptions {
+    TaskPriority priority = TaskPriority::NORMAL;
+    // queued tasks of the same priority run earliest deadline first, ahead of the ones without.
+    // only an ordering hint: a task past its deadline still runs. BACKGROUND tasks ignore it and
+    // run in submission order, so the oldest one is always the next to go
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    // the task is dropped before it starts once this is stopped, see ThreadPool::enqueue
+    std::stop_token stop_token;
+};
+
+// the tasks ThreadPool queues outside its regular queues: HIGH and BACKGROUND tasks, and
+// NORMAL tasks with a deadline. not thread-safe, the pool guards it with a mutex; only
+// size() may be read without one
+class PriorityLanes {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // HIGH tasks (and NORMAL ones with a deadline) taken in a row before plain
+    // NORMAL tasks that are waiting get a turn
+    static constexpr size_t URGENT_BURST = 16;
+
+    explicit PriorityLanes(Clock::duration starvation_limit)
+        : _starvation_limit(starvation_limit) {}
+
+    void push(const TaskOptions& options, InlineTask task) {
+        if (options.priority == TaskPriority::BACKGROUND) {
+            _background.push_back(Entry{ Clock::time_point::max(), _next_sequence++, Clock::now(), std::move(task) });
+        } else {
+            std::vector<Entry>& lane = this->lane(options.priority);
+            lane.push_back(Entry{ options.deadline.value_or(Clock::time_point::max()), _next_sequence++,
+                                  Clock::now(), std::move(task) });
+            std::push_heap(lane.begin(), lane.end(), Later{});
+        }
+        _size.store(_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // the task that should run before the regular queues are looked at: the next BACKGROUND task
+    // once it has waited for starvation_limit, then HIGH, then NORMAL with a deadline.
+    // normal_waiting says whether the regular queues have something, see URGENT_BURST
+    auto pop_urgent(bool normal_waiting, InlineTask& task, TaskPriority& priority) -> bool {
+        if (!_background.empty() && Clock::now() - _background.front().queued_at >= _starvation_limit) {
+            pop(TaskPriority::BACKGROUND, task, priority);
+            return true;
+        }
+        if (_urgent_streak >= URGENT_BURST && normal_waiting) {
+            _urgent_streak = 0;
+            return false;
+        }
+        for (const TaskPriority lane_priority : { TaskPriority::HIGH, TaskPriority::NORMAL }) {
+            if (!lane(lane_priority).empty()) {
+                pop(lane_priority, task, priority);
+                ++_urgent_streak;
+                return true;
+            }
+        }
+        _urgent_streak = 0;
+        return false;
+    }
+
+    // a BACKGROUND task, for a worker that found nothing else to do
+    auto pop_background(InlineTask& task, TaskPriority& priority) -> bool {
+        if (_background.empty()) {
+            return false;
+        }
+        pop(TaskPriority::BACKGROUND, task, priority);
+        return true;
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+    [[nodiscard]] auto size() const -> size_t { return _size.load(std::memory_order_relaxed); }
+
+private:
+    // HIGH and NORMAL, BACKGROUND has its own FIFO
+    static constexpr size_t LANES = 2;
+
+    struct Entry {
+        Clock::time_point deadline;
+        uint64_t sequence;
+        Clock::time_point queued_at;
+        InlineTask task;
+    };
+
+    // heap order: earliest deadline first, then first come first served
+    struct Later {
+        auto operator()(const Entry& lhs, const Entry& rhs) const -> bool {
+            if (lhs.deadline != rhs.deadline) {
+                return lhs.deadline > rhs.deadline;
+            }
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    auto lane(TaskPriority priority) -> std::vector<Entry>& { return _lanes[static_cast<size_t>(priority)]; }
+
+    void pop(TaskPriority from, InlineTask& task, TaskPriority& priority) {
+        if (from == TaskPriority::BACKGROUND) {
+            task = std::move(_background.front().task);
+            _background.pop_front();
+        } else {
+            std::vector<Entry>& entries = lane(from);
+            std::pop_heap(entries.begin(), entries.end(), Later{});
+            task = std::move(entries.back().task);
+            entries.pop_back();
+        }
+        priority = from;
+        _size.store(_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+
+    Clock::duration _starvation_limit;
+    std::array<std::vector<Entry>, LANES> _lanes;
+    std::deque<Entry> _background;
+    uint64_t _next_sequence = 0;
+    size_t _urgent_streak = 0;
+    std::atomic<size_t> _size{ 0 };
+};
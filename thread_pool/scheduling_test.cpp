@@ -0,0 +1,185 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+    // keeps a worker busy until opened
+    class Gate {
+    public:
+        void enter() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _entered = true;
+            _condition.notify_all();
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _open;
+                });
+        }
+
+        void wait_entered() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _entered;
+                });
+        }
+
+        void open() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _open = true;
+            _condition.notify_all();
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _entered = false;
+        bool _open = false;
+    };
+
+    // a single worker, blocked on gate until the test has queued everything
+    auto make_pool(SchedulingMode mode) -> ThreadPoolConfig {
+        ThreadPoolConfig config;
+        config.threads = 1;
+        config.mode = mode;
+        config.starvation_limit = std::chrono::hours(1);
+        return config;
+    }
+
+    void block(ThreadPool& pool, Gate& gate) {
+        pool.post([&gate]() { gate.enter(); });
+        gate.wait_entered();
+    }
+
+    template <typename T>
+    auto broken(std::future<T>& future) -> bool {
+        try {
+            future.get();
+        } catch (const std::future_error& error) {
+            return error.code() == std::future_errc::broken_promise;
+        }
+        return false;
+    }
+
+} // namespace
+
+int main() {
+    using namespace std::chrono_literals;
+
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        // HIGH first, deadlines earliest first, BACKGROUND only once nothing else is queued
+        {
+            ThreadPool pool(make_pool(mode));
+            Gate gate;
+            block(pool, gate);
+
+            std::string order;
+            const auto now = std::chrono::steady_clock::now();
+            pool.post_with(TaskOptions{ TaskPriority::BACKGROUND, std::nullopt, {} }, [&order]() { order += 'b'; });
+            pool.post([&order]() { order += 'n'; });
+            pool.post_with(TaskOptions{ TaskPriority::NORMAL, now + 2s, {} }, [&order]() { order += '2'; });
+            pool.post_with(TaskOptions{ TaskPriority::NORMAL, now + 1s, {} }, [&order]() { order += '1'; });
+            pool.post_with(TaskOptions{ TaskPriority::HIGH, std::nullopt, {} }, [&order]() { order += 'h'; });
+            gate.open();
+            pool.wait_idle();
+
+            if (order != "h12nb") {
+                std::printf("mode %d: ran in order %s, expected h12nb\n", static_cast<int>(mode), order.c_str());
+                ++failures;
+            }
+        }
+
+        // a stopped token drops the task before it starts
+        {
+            ThreadPool pool(make_pool(mode));
+            Gate gate;
+            block(pool, gate);
+
+            std::stop_source source;
+            bool ran = false;
+            std::future<void> dropped = pool.enqueue(source.get_token(), [&ran]() { ran = true; });
+            std::future<int> kept = pool.enqueue(std::stop_token{}, []() { return 1; });
+            source.request_stop();
+            gate.open();
+
+            if (!broken(dropped) || ran || kept.get() != 1 || pool.cancelled_count() != 1) {
+                std::printf("mode %d: cancelled task %s, %zu cancelled\n", static_cast<int>(mode),
+                            ran ? "ran" : "didn't run", pool.cancelled_count());
+                ++failures;
+            }
+        }
+
+        // SHED drops enqueued tasks that waited past queue_budget, posted ones still run
+        {
+            ThreadPoolConfig config = make_pool(mode);
+            config.overload_policy = OverloadPolicy::SHED;
+            config.queue_budget = 1ms;
+            ThreadPool pool(config);
+            Gate gate;
+            block(pool, gate);
+
+            bool posted_ran = false;
+            std::future<void> late = pool.enqueue([]() {});
+            pool.post([&posted_ran]() { posted_ran = true; });
+            std::this_thread::sleep_for(20ms);
+            gate.open();
+            pool.wait_idle();
+
+            if (!broken(late) || !posted_ran || pool.shed_count() != 1) {
+                std::printf("mode %d: %zu shed, posted task %s\n", static_cast<int>(mode), pool.shed_count(),
+                            posted_ran ? "ran" : "was dropped");
+                ++failures;
+            }
+        }
+    }
+
+    // REJECT refuses new tasks for one queue_budget after shedding one
+    {
+        ThreadPoolConfig config = make_pool(SchedulingMode::SHARED_QUEUE);
+        config.overload_policy = OverloadPolicy::REJECT;
+        config.queue_budget = 200ms;
+        ThreadPool pool(config);
+        Gate gate;
+        block(pool, gate);
+
+        std::future<void> late = pool.enqueue([]() {});
+        std::this_thread::sleep_for(300ms);
+        gate.open();
+        const bool shed = broken(late);
+
+        bool rejected = false;
+        try {
+            pool.enqueue([]() {}).get();
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        const bool refused = !pool.try_enqueue([]() {}).has_value();
+        std::this_thread::sleep_for(300ms);
+        const bool accepted_again = pool.try_enqueue([]() {}).has_value();
+
+        if (!shed || !rejected || !refused || !accepted_again || pool.rejected_count() != 2) {
+            std::printf("REJECT: shed %d, enqueue rejected %d, try_enqueue refused %d, accepted again %d, %zu rejected\n",
+                        shed, rejected, refused, accepted_again, pool.rejected_count());
+            ++failures;
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("scheduling: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
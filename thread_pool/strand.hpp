@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "inline_task.hpp"
+#include "thread_pool.hpp"
+
+namespace strand_detail {
+
+    struct NodeBase {
+        std::atomic<NodeBase*> next{ nullptr };
+    };
+
+    struct Node : NodeBase {
+        explicit Node(InlineTask task)
+            : task(std::move(task)) {}
+
+        InlineTask task;
+    };
+
+    // the tasks of one strand. an intrusive Vyukov queue: producers swap themselves into
+    // _tail and then link the previous node, only the single running drain pops at _head.
+    // _count says how many tasks are in, the producer that raises it from 0 starts the drain
+    class State : public std::enable_shared_from_this<State> {
+    public:
+        // tasks run back to back before the drain gives the worker back to the pool
+        static constexpr size_t BATCH = 64;
+
+        explicit State(ThreadPool& pool)
+            : _pool(pool),
+              _resource(pool.memory_resource()) {}
+
+        State(const State&) = delete;
+        State& operator=(const State&) = delete;
+        State(State&&) = delete;
+        State& operator=(State&&) = delete;
+
+        ~State() {
+            while (NodeBase* node = pop()) {
+                free_node(static_cast<Node*>(node));
+            }
+        }
+
+        void push(InlineTask task) {
+            Node* node = make_node(std::move(task));
+            NodeBase* previous = _tail.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+
+            if (_count.fetch_add(1, std::memory_order_acq_rel) == 0) {
+                try {
+                    schedule();
+                } catch (...) {
+                    unschedule();
+                    throw;
+                }
+            }
+        }
+
+        [[nodiscard]] auto running_in_this_thread() const -> bool { return _current == this; }
+
+        [[nodiscard]] auto resource() const -> std::pmr::memory_resource* { return _resource; }
+
+    private:
+        auto make_node(InlineTask task) -> Node* {
+            if (_resource == nullptr) {
+                return new Node(std::move(task));
+            }
+            return std::pmr::polymorphic_allocator<>(_resource).new_object<Node>(std::move(task));
+        }
+
+        void free_node(Node* node) {
+            if (_resource == nullptr) {
+                delete node;
+            } else {
+                std::pmr::polymorphic_allocator<>(_resource).delete_object(node);
+            }
+        }
+
+        void schedule() {
+            _pool.post([self = this->shared_from_this()]() { self->drain(); });
+        }
+
+        // the pool refused the drain (it stopped, say), so nothing runs this strand: take the
+        // tasks back out, the one that failed to post first, until _count is 0 again or a
+        // drain got through for tasks other producers added meanwhile. those are dropped too
+        // if the pool refuses them as well, a later post can then schedule again
+        void unschedule() {
+            while (true) {
+                free_node(static_cast<Node*>(pop_published()));
+                if (_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    return;
+                }
+                try {
+                    schedule();
+                    return;
+                } catch (...) {
+                    // drop the next one as well
+                }
+            }
+        }
+
+        // runs up to BATCH tasks in order. a task that throws ends the batch, and its
+        // exception goes on to the pool's on_exception once the rest is rescheduled
+        void drain() {
+            const State* const outer = std::exchange(_current, this);
+            for (size_t ran = 1;; ++ran) {
+                auto* node = static_cast<Node*>(pop_published());
+                std::exception_ptr error;
+                try {
+                    node->task();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                free_node(node);
+
+                const bool last = _count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+                if (last || error || ran == BATCH) {
+                    _current = outer;
+                    if (!last) {
+                        schedule();
+                    }
+                    if (error) {
+                        std::rethrow_exception(error);
+                    }
+                    return;
+                }
+            }
+        }
+
+        // _count promised a task: wait out a producer between its swap and its link
+        auto pop_published() -> NodeBase* {
+            while (true) {
+                if (NodeBase* node = pop()) {
+                    return node;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        // nullptr if the queue is empty or the next producer hasn't linked its node yet
+        auto pop() -> NodeBase* {
+            NodeBase* head = _head;
+            NodeBase* next = head->next.load(std::memory_order_acquire);
+            if (head == &_stub) {
+                if (next == nullptr) {
+                    return nullptr;
+                }
+                _head = next;
+                head = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr) {
+                _head = next;
+                return head;
+            }
+            if (head != _tail.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            // head is the last node: put the stub behind it so head can be handed out
+            _stub.next.store(nullptr, std::memory_order_relaxed);
+            NodeBase* previous = _tail.exchange(&_stub, std::memory_order_acq_rel);
+            previous->next.store(&_stub, std::memory_order_release);
+            next = head->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                _head = next;
+                return head;
+            }
+            return nullptr;
+        }
+
+        ThreadPool& _pool;
+        // where nodes come from, see ThreadPoolConfig::memory_resource. nullptr for the heap
+        std::pmr::memory_resource* _resource;
+        NodeBase _stub;
+        NodeBase* _head = &_stub;
+        std::atomic<NodeBase*> _tail{ &_stub };
+        std::atomic<size_t> _count{ 0 };
+
+        // the strand whose drain runs on this thread
+        inline static thread_local const State* _current = nullptr;
+    };
+
+} // namespace strand_detail
+
+// a serial executor on top of a ThreadPool: tasks posted to the same strand run one at a
+// time in posting order, on whatever worker is free, while different strands run in
+// parallel. no lock is held while a task runs, and an idle strand is a few pointers, so
+// one per connection or account is fine. copies share the same queue
+class Strand {
+public:
+    explicit Strand(ThreadPool& pool)
+        : _state(pool.memory_resource() == nullptr
+                     ? std::make_shared<strand_detail::State>(pool)
+                     : std::allocate_shared<strand_detail::State>(
+                           std::pmr::polymorphic_allocator<strand_detail::State>(pool.memory_resource()), pool)) {}
+
+    // queues f(args...) behind everything posted to this strand before. throws like
+    // ThreadPool::post if the pool refuses to run the strand, the task isn't queued then
+    template <typename F, typename... Args>
+    void post(F&& f, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            _state->push(InlineTask(std::allocator_arg, _state->resource(), std::forward<F>(f)));
+        } else {
+            _state->push(InlineTask(
+                std::allocator_arg, _state->resource(),
+                [f = std::forward<F>(f),
+                 args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+                    std::apply(std::move(f), std::move(args));
+                }));
+        }
+    }
+
+    // true inside a task of this strand
+    [[nodiscard]] auto running_in_this_thread() const -> bool { return _state->running_in_this_thread(); }
+
+private:
+    std::shared_ptr<strand_detail::State> _state;
+};
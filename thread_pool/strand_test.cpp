@@ -0,0 +1,91 @@
+#include <atomic>
+#include <cstdio>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "strand.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+    constexpr int PRODUCERS = 4;
+    constexpr int TASKS_PER_PRODUCER = 2000;
+
+    // what the tasks of one strand saw: overlapping runs and tasks of a producer out of order
+    struct Checks {
+        std::atomic<bool> running{ false };
+        std::atomic<int> overlaps{ 0 };
+        std::atomic<int> reorders{ 0 };
+        std::atomic<int> outside{ 0 };
+        std::atomic<int> ran{ 0 };
+        // only touched by the strand's tasks, which never run at the same time
+        int last[PRODUCERS] = {};
+    };
+
+    void produce(Strand& strand, Checks& checks, int producer) {
+        for (int i = 1; i <= TASKS_PER_PRODUCER; ++i) {
+            strand.post(
+                [&strand, &checks, producer, i]() {
+                    if (checks.running.exchange(true, std::memory_order_acquire)) {
+                        checks.overlaps.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    if (!strand.running_in_this_thread()) {
+                        checks.outside.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    if (checks.last[producer] != i - 1) {
+                        checks.reorders.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    checks.last[producer] = i;
+                    checks.ran.fetch_add(1, std::memory_order_relaxed);
+                    checks.running.store(false, std::memory_order_release);
+                });
+        }
+    }
+
+} // namespace
+
+int main() {
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        ThreadPoolConfig config;
+        config.threads = 4;
+        config.mode = mode;
+        config.queue_capacity = 64;
+        ThreadPool pool(config);
+
+        // two strands fed at once, half of the producers outside the pool and half on its workers
+        Strand strands[2] = { Strand(pool), Strand(pool) };
+        Checks checks[2];
+        std::vector<std::thread> outside;
+        for (int producer = 0; producer < PRODUCERS; ++producer) {
+            for (int s = 0; s < 2; ++s) {
+                if (producer % 2 == 0) {
+                    outside.emplace_back([&strands, &checks, s, producer]() { produce(strands[s], checks[s], producer); });
+                } else {
+                    pool.post([&strands, &checks, s, producer]() { produce(strands[s], checks[s], producer); });
+                }
+            }
+        }
+        for (std::thread& thread : outside) {
+            thread.join();
+        }
+        pool.wait_idle();
+
+        for (int s = 0; s < 2; ++s) {
+            const Checks& c = checks[s];
+            if (c.ran != PRODUCERS * TASKS_PER_PRODUCER || c.overlaps != 0 || c.reorders != 0 || c.outside != 0) {
+                std::printf("mode %d, strand %d: %d ran, %d overlapping, %d out of order, %d outside the strand\n",
+                            static_cast<int>(mode), s, c.ran.load(), c.overlaps.load(), c.reorders.load(),
+                            c.outside.load());
+                ++failures;
+            }
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("strand ordering: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
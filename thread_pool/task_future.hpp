@@ -0,0 +1,374 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "inline_task.hpp"
+#include "thread_pool.hpp"
+
+template <typename T>
+class TaskFuture;
+
+namespace future_detail {
+
+    template <typename T>
+    using stored_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    template <typename T>
+    struct get_result {
+        using type = const T&;
+    };
+
+    template <>
+    struct get_result<void> {
+        using type = void;
+    };
+
+    // result slot shared by a TaskFuture and whoever produces its value.
+    // callbacks registered before completion run on the completing thread
+    template <typename T>
+    class State {
+    public:
+        template <typename... Value>
+        void set_value(Value&&... value) {
+            std::vector<InlineTask> callbacks;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _value.emplace(std::forward<Value>(value)...);
+                _ready.store(true, std::memory_order_release);
+                callbacks.swap(_callbacks);
+            }
+            _ready_condition.notify_all();
+            for (InlineTask& callback : callbacks) {
+                callback();
+            }
+        }
+
+        void set_error(std::exception_ptr error) {
+            std::vector<InlineTask> callbacks;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _error = std::move(error);
+                _ready.store(true, std::memory_order_release);
+                callbacks.swap(_callbacks);
+            }
+            _ready_condition.notify_all();
+            for (InlineTask& callback : callbacks) {
+                callback();
+            }
+        }
+
+        // stores f()'s result, or the exception it threw
+        template <typename F>
+        void fulfil(F&& f) {
+            if constexpr (std::is_void_v<T>) {
+                try {
+                    std::forward<F>(f)();
+                } catch (...) {
+                    set_error(std::current_exception());
+                    return;
+                }
+                set_value();
+            } else {
+                std::optional<T> result;
+                try {
+                    result.emplace(std::forward<F>(f)());
+                } catch (...) {
+                    set_error(std::current_exception());
+                    return;
+                }
+                set_value(std::move(*result));
+            }
+        }
+
+        // runs callback once the state is ready, right here if it already is
+        void on_ready(InlineTask callback) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_ready.load(std::memory_order_relaxed)) {
+                    _callbacks.emplace_back(std::move(callback));
+                    return;
+                }
+            }
+            callback();
+        }
+
+        [[nodiscard]] auto is_ready() const -> bool { return _ready.load(std::memory_order_acquire); }
+
+        void wait() {
+            if (is_ready()) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ready_condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _ready.load(std::memory_order_relaxed);
+                });
+        }
+
+        template <typename Rep, typename Period>
+        void wait_for(std::chrono::duration<Rep, Period> timeout) {
+            if (is_ready()) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ready_condition.wait_for(
+                lock,
+                timeout,
+                [this]() -> bool {
+                    return _ready.load(std::memory_order_relaxed);
+                });
+        }
+
+        // only valid once the state is ready
+        [[nodiscard]] auto error() const -> std::exception_ptr { return _error; }
+
+        auto value() -> const stored_t<T>& {
+            wait();
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            return *_value;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _ready_condition;
+        std::atomic<bool> _ready{ false };
+        std::optional<stored_t<T>> _value;
+        std::exception_ptr _error;
+        std::vector<InlineTask> _callbacks;
+    };
+
+    // states of futures tied to a pool come from its task memory, see ThreadPoolConfig::memory_resource
+    template <typename T>
+    auto make_state(ThreadPool* pool) -> std::shared_ptr<State<T>> {
+        if (pool == nullptr || pool->memory_resource() == nullptr) {
+            return std::make_shared<State<T>>();
+        }
+        return std::allocate_shared<State<T>>(std::pmr::polymorphic_allocator<State<T>>(pool->memory_resource()));
+    }
+
+    template <typename T, typename F>
+    struct then_result {
+        using type = std::invoke_result_t<F&, const T&>;
+    };
+
+    template <typename F>
+    struct then_result<void, F> {
+        using type = std::invoke_result_t<F&>;
+    };
+
+} // namespace future_detail
+
+// a future that can be chained: then() schedules the continuation on the pool once the
+// value is there, so no worker ever blocks waiting for its inputs.
+// copies share the same result, like std::shared_future
+template <typename T>
+class TaskFuture {
+public:
+    TaskFuture() = default;
+
+    TaskFuture(ThreadPool* pool, std::shared_ptr<future_detail::State<T>> state)
+        : _pool(pool),
+          _state(std::move(state)) {}
+
+    [[nodiscard]] auto valid() const -> bool { return _state != nullptr; }
+    [[nodiscard]] auto is_ready() const -> bool { return _state->is_ready(); }
+    [[nodiscard]] auto pool() const -> ThreadPool* { return _pool; }
+
+    // on a worker of the future's pool this runs other queued tasks until the value is
+    // there, so nested waits can't deadlock the pool. elsewhere it just blocks
+    void wait() const {
+        if (_pool == nullptr) {
+            _state->wait();
+            return;
+        }
+        _pool->help_until(
+            [this]() -> bool {
+                return _state->is_ready();
+            },
+            [this](std::chrono::microseconds timeout) { _state->wait_for(timeout); });
+    }
+
+    // waits like wait(), rethrows the task's exception
+    auto get() const -> typename future_detail::get_result<T>::type {
+        wait();
+        if constexpr (std::is_void_v<T>) {
+            _state->value();
+        } else {
+            return _state->value();
+        }
+    }
+
+    // runs f(value) (or f() for void) on the pool once this future is ready.
+    // an exception is passed on to the returned future without calling f.
+    // futures without a pool, like when_all() of nothing, run f on the completing thread
+    template <typename F>
+    auto then(F&& f) const -> TaskFuture<typename future_detail::then_result<T, std::decay_t<F>>::type>;
+
+    // lets when_all/when_any/TaskGraph reach the shared state
+    [[nodiscard]] auto state() const -> const std::shared_ptr<future_detail::State<T>>& { return _state; }
+
+private:
+    ThreadPool* _pool = nullptr;
+    std::shared_ptr<future_detail::State<T>> _state;
+};
+
+template <typename T>
+template <typename F>
+auto TaskFuture<T>::then(F&& f) const -> TaskFuture<typename future_detail::then_result<T, std::decay_t<F>>::type> {
+    using result_type = typename future_detail::then_result<T, std::decay_t<F>>::type;
+
+    auto next = future_detail::make_state<result_type>(_pool);
+    _state->on_ready(
+        [pool = _pool, source = _state, next, f = std::forward<F>(f)]() mutable {
+            if (auto error = source->error()) {
+                next->set_error(std::move(error));
+                return;
+            }
+
+            auto run = [source, next, f = std::move(f)]() mutable {
+                next->fulfil(
+                    [&]() -> result_type {
+                        if constexpr (std::is_void_v<T>) {
+                            return f();
+                        } else {
+                            return f(source->value());
+                        }
+                    });
+            };
+
+            if (pool == nullptr) {
+                run();
+                return;
+            }
+            try {
+                pool->post(std::move(run));
+            } catch (...) {
+                next->set_error(std::current_exception());
+            }
+        });
+    return TaskFuture<result_type>(_pool, std::move(next));
+}
+
+// runs f(args...) on the pool and returns a future that supports then()
+template <typename F, typename... Args>
+auto spawn(ThreadPool& pool, F&& f, Args&&... args) -> TaskFuture<std::invoke_result_t<F, Args...>> {
+    using return_type = std::invoke_result_t<F, Args...>;
+
+    auto state = future_detail::make_state<return_type>(&pool);
+    pool.post(
+        [state,
+         f = std::forward<F>(f),
+         args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+            state->fulfil(
+                [&]() -> return_type {
+                    return std::apply(std::move(f), std::move(args));
+                });
+        });
+    return TaskFuture<return_type>(&pool, std::move(state));
+}
+
+// a future that is already ready, handy as a seed for then() chains
+template <typename T>
+auto make_ready_future(ThreadPool& pool, T value) -> TaskFuture<T> {
+    auto state = future_detail::make_state<T>(&pool);
+    state->set_value(std::move(value));
+    return TaskFuture<T>(&pool, std::move(state));
+}
+
+// ready once every input is ready; the inputs come back so their values or errors can be read
+template <typename T>
+auto when_all(std::vector<TaskFuture<T>> futures) -> TaskFuture<std::vector<TaskFuture<T>>> {
+    using result_type = std::vector<TaskFuture<T>>;
+
+    struct Join {
+        explicit Join(result_type futures)
+            : remaining(futures.size() + 1),
+              futures(std::move(futures)) {}
+
+        std::atomic<size_t> remaining;
+        result_type futures;
+    };
+
+    ThreadPool* pool = futures.empty() ? nullptr : futures.front().pool();
+    auto state = future_detail::make_state<result_type>(pool);
+    auto join = std::make_shared<Join>(std::move(futures));
+
+    auto arrive = [join, state]() {
+        if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            state->set_value(std::move(join->futures));
+        }
+    };
+    // the extra count keeps the last callback from moving the vector while we walk it
+    for (const TaskFuture<T>& future : join->futures) {
+        future.state()->on_ready(arrive);
+    }
+    arrive();
+
+    return TaskFuture<result_type>(pool, std::move(state));
+}
+
+template <typename... Ts>
+auto when_all(TaskFuture<Ts>... futures) -> TaskFuture<std::tuple<TaskFuture<Ts>...>> {
+    using result_type = std::tuple<TaskFuture<Ts>...>;
+
+    struct Join {
+        explicit Join(result_type futures)
+            : futures(std::move(futures)) {}
+
+        std::atomic<size_t> remaining{ sizeof...(Ts) + 1 };
+        result_type futures;
+    };
+
+    ThreadPool* pool = nullptr;
+    ((pool = pool != nullptr ? pool : futures.pool()), ...);
+
+    auto state = future_detail::make_state<result_type>(pool);
+    auto join = std::make_shared<Join>(result_type(std::move(futures)...));
+
+    auto arrive = [join, state]() {
+        if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            state->set_value(std::move(join->futures));
+        }
+    };
+    std::apply([&](const auto&... future) { (future.state()->on_ready(arrive), ...); }, join->futures);
+    arrive();
+
+    return TaskFuture<result_type>(pool, std::move(state));
+}
+
+// ready with the index of the first input to become ready
+template <typename T>
+auto when_any(const std::vector<TaskFuture<T>>& futures) -> TaskFuture<size_t> {
+    if (futures.empty()) {
+        throw std::invalid_argument("when_any needs at least one future");
+    }
+
+    auto state = future_detail::make_state<size_t>(futures.front().pool());
+    auto decided = std::make_shared<std::atomic<bool>>(false);
+    for (size_t i = 0; i < futures.size(); ++i) {
+        futures[i].state()->on_ready(
+            [state, decided, i]() {
+                if (!decided->exchange(true, std::memory_order_acq_rel)) {
+                    state->set_value(i);
+                }
+            });
+    }
+    return TaskFuture<size_t>(futures.front().pool(), std::move(state));
+}
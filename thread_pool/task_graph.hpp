@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "task_future.hpp"
+#include "thread_pool.hpp"
+
+// a set of tasks with dependencies between them. run() starts the tasks without
+// dependencies, and every other task is enqueued by the last of its inputs to finish.
+// a task can only depend on tasks added before it, so the graph is always acyclic
+class TaskGraph {
+public:
+    using NodeId = size_t;
+
+    auto add(std::function<void()> task, const std::vector<NodeId>& dependencies = {}) -> NodeId {
+        const NodeId id = _nodes.size();
+        for (NodeId dependency : dependencies) {
+            if (dependency >= id) {
+                throw std::invalid_argument("TaskGraph dependency must be added before its dependent");
+            }
+        }
+
+        _nodes.push_back(Node{ std::move(task), {}, dependencies.size() });
+        for (NodeId dependency : dependencies) {
+            _nodes[dependency].dependents.push_back(id);
+        }
+        return id;
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return _nodes.size(); }
+
+    // ready once every task ran. after the first exception the remaining tasks are
+    // skipped and the returned future carries that exception.
+    // the graph is copied, so it can be changed or destroyed while the run is going
+    auto run(ThreadPool& pool) const -> TaskFuture<void>;
+
+private:
+    struct Node {
+        std::function<void()> task;
+        std::vector<NodeId> dependents;
+        size_t dependency_count;
+    };
+
+    class Run : public std::enable_shared_from_this<Run> {
+    public:
+        Run(ThreadPool& pool, std::vector<Node> nodes)
+            : _pool(pool),
+              _nodes(std::move(nodes)),
+              _remaining_dependencies(std::make_unique<std::atomic<size_t>[]>(_nodes.size())),
+              _unfinished(_nodes.size()),
+              _done(std::make_shared<future_detail::State<void>>()) {
+            for (size_t i = 0; i < _nodes.size(); ++i) {
+                _remaining_dependencies[i].store(_nodes[i].dependency_count, std::memory_order_relaxed);
+            }
+        }
+
+        void start() {
+            if (_nodes.empty()) {
+                _done->set_value();
+                return;
+            }
+            for (NodeId id = 0; id < _nodes.size(); ++id) {
+                if (_nodes[id].dependency_count == 0) {
+                    schedule(id);
+                }
+            }
+        }
+
+        [[nodiscard]] auto done() const -> const std::shared_ptr<future_detail::State<void>>& { return _done; }
+
+    private:
+        void schedule(NodeId id) {
+            try {
+                _pool.post([self = this->shared_from_this(), id]() { self->execute(id); });
+            } catch (...) {
+                fail(std::current_exception());
+                execute(id);
+            }
+        }
+
+        void execute(NodeId id) {
+            if (!_failed.load(std::memory_order_acquire)) {
+                try {
+                    _nodes[id].task();
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+
+            for (NodeId dependent : _nodes[id].dependents) {
+                if (_remaining_dependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    schedule(dependent);
+                }
+            }
+
+            if (_unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (_error) {
+                    _done->set_error(_error);
+                } else {
+                    _done->set_value();
+                }
+            }
+        }
+
+        void fail(std::exception_ptr error) {
+            std::unique_lock<std::mutex> lock(_error_mutex);
+            if (!_error) {
+                _error = std::move(error);
+            }
+            _failed.store(true, std::memory_order_release);
+        }
+
+        ThreadPool& _pool;
+        const std::vector<Node> _nodes;
+        std::unique_ptr<std::atomic<size_t>[]> _remaining_dependencies;
+        std::atomic<size_t> _unfinished;
+        std::atomic<bool> _failed{ false };
+        std::mutex _error_mutex;
+        std::exception_ptr _error;
+        std::shared_ptr<future_detail::State<void>> _done;
+    };
+
+    std::vector<Node> _nodes;
+};
+
+inline auto TaskGraph::run(ThreadPool& pool) const -> TaskFuture<void> {
+    auto run = std::make_shared<Run>(pool, _nodes);
+    run->start();
+    return TaskFuture<void>(&pool, run->done());
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <optional>
+
+// the pool's memory_resource when ThreadPoolConfig::memory_resource is set. each worker
+// allocates from its own arena, an unsynchronized pool resource no other thread touches,
+// so the common case takes no lock and writes no shared cache line. every block starts
+// with a header naming its arena: the owner frees straight into the arena, other threads
+// push the block onto the arena's lock-free remote list, and the owner takes those back
+// on its next allocation. threads outside the pool and over-aligned requests go upstream
+class TaskMemory : public std::pmr::memory_resource {
+public:
+    TaskMemory(std::pmr::memory_resource* upstream, size_t arenas)
+        : _upstream(upstream),
+          _arenas(std::make_unique<Arena[]>(arenas)),
+          _arena_count(arenas) {
+        for (size_t i = 0; i < arenas; ++i) {
+            _arenas[i].memory = this;
+            _arenas[i].pool.emplace(upstream);
+        }
+    }
+
+    TaskMemory(const TaskMemory&) = delete;
+    TaskMemory& operator=(const TaskMemory&) = delete;
+    TaskMemory(TaskMemory&&) = delete;
+    TaskMemory& operator=(TaskMemory&&) = delete;
+
+    ~TaskMemory() override = default;
+
+    // makes the calling thread the owner of an arena, every worker does this as it starts
+    void bind(size_t arena) { _current_arena = &_arenas[arena]; }
+
+    // called by the pool once its workers are gone, instead of delete. blocks that are
+    // still out (futures or strands that outlive the pool) keep the arenas alive, and
+    // whoever frees the last of them deletes the TaskMemory
+    void close() {
+        {
+            std::unique_lock<std::mutex> lock(_closed_mutex);
+            size_t outstanding = 0;
+            for (size_t i = 0; i < _arena_count; ++i) {
+                Arena& arena = _arenas[i];
+                reclaim(arena, arena.remote.exchange(closed_list(), std::memory_order_acquire));
+                outstanding += arena.live;
+            }
+            // under the lock, so late frees of arena blocks only count down after this
+            _outstanding.fetch_add(outstanding, std::memory_order_relaxed);
+        }
+        release();
+    }
+
+private:
+    // room for the arena pointer and the block size, and keeps the payload max-aligned
+    static constexpr size_t HEADER_SIZE = alignof(std::max_align_t) > 16 ? alignof(std::max_align_t) : 16;
+
+    struct Arena;
+
+    struct Header {
+        Arena* arena;
+        size_t total;
+
+        // the payload of a block on a remote list holds the next block
+        [[nodiscard]] auto next() -> Header*& { return *reinterpret_cast<Header**>(reinterpret_cast<char*>(this) + HEADER_SIZE); }
+    };
+
+    struct alignas(64) Arena {
+        TaskMemory* memory = nullptr;
+        std::optional<std::pmr::unsynchronized_pool_resource> pool;
+        // blocks handed out and not yet back in the pool, only touched by the owner
+        size_t live = 0;
+        // blocks freed by other threads, closed_list() once the pool is gone
+        std::atomic<Header*> remote{ nullptr };
+    };
+
+    static auto closed_list() -> Header* { return reinterpret_cast<Header*>(std::uintptr_t{ 1 }); }
+
+    auto do_allocate(size_t bytes, size_t alignment) -> void* override {
+        // no room for a header, but counted like any other upstream block so it keeps us alive
+        if (alignment > HEADER_SIZE) {
+            void* block = _upstream->allocate(bytes, alignment);
+            _outstanding.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        const size_t total = HEADER_SIZE + std::max(bytes, sizeof(Header*));
+        Arena* arena = _current_arena;
+        void* block = nullptr;
+        if (arena != nullptr && arena->memory == this) {
+            if (arena->remote.load(std::memory_order_relaxed) != nullptr) {
+                reclaim(*arena, arena->remote.exchange(nullptr, std::memory_order_acquire));
+            }
+            block = arena->pool->allocate(total, HEADER_SIZE);
+            ++arena->live;
+        } else {
+            arena = nullptr;
+            block = _upstream->allocate(total, HEADER_SIZE);
+            _outstanding.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto* header = ::new (block) Header{ arena, total };
+        return reinterpret_cast<char*>(header) + HEADER_SIZE;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        if (alignment > HEADER_SIZE) {
+            _upstream->deallocate(pointer, bytes, alignment);
+            release();
+            return;
+        }
+
+        auto* header = reinterpret_cast<Header*>(static_cast<char*>(pointer) - HEADER_SIZE);
+        Arena* arena = header->arena;
+        if (arena == nullptr) {
+            _upstream->deallocate(header, header->total, HEADER_SIZE);
+            release();
+            return;
+        }
+        if (arena == _current_arena) {
+            arena->pool->deallocate(header, header->total, HEADER_SIZE);
+            --arena->live;
+            return;
+        }
+
+        Header* head = arena->remote.load(std::memory_order_relaxed);
+        do {
+            if (head == closed_list()) {
+                free_after_close(*arena, header);
+                return;
+            }
+            header->next() = head;
+        } while (!arena->remote.compare_exchange_weak(head, header, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+    }
+
+    [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override {
+        return this == &other;
+    }
+
+    // the owner, or close() with _closed_mutex held, puts a remote list back into the arena
+    static void reclaim(Arena& arena, Header* list) {
+        while (list != nullptr) {
+            Header* next = list->next();
+            arena.pool->deallocate(list, list->total, HEADER_SIZE);
+            --arena.live;
+            list = next;
+        }
+    }
+
+    // nobody owns the arena any more, late frees take turns
+    void free_after_close(Arena& arena, Header* header) {
+        bool last = false;
+        {
+            std::unique_lock<std::mutex> lock(_closed_mutex);
+            arena.pool->deallocate(header, header->total, HEADER_SIZE);
+            last = _outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+        if (last) {
+            delete this;
+        }
+    }
+
+    void release() {
+        if (_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    std::pmr::memory_resource* _upstream;
+    std::unique_ptr<Arena[]> _arenas;
+    size_t _arena_count;
+    std::mutex _closed_mutex;
+    // upstream blocks (over-aligned ones too), arena blocks left at close() and one for the
+    // pool until it closes us
+    std::atomic<size_t> _outstanding{ 1 };
+
+    inline static thread_local Arena* _current_arena = nullptr;
+};
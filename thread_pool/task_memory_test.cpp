@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <initializer_list>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "strand.hpp"
+#include "task_future.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+    // upstream that counts the blocks it handed out, so leaks and early frees show up without a sanitizer
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        [[nodiscard]] auto live() const -> long { return _live.load(std::memory_order_relaxed); }
+
+    private:
+        auto do_allocate(size_t bytes, size_t alignment) -> void* override {
+            void* block = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            _live.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        void do_deallocate(void* block, size_t bytes, size_t alignment) override {
+            _live.fetch_sub(1, std::memory_order_relaxed);
+            std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+        }
+
+        [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override {
+            return this == &other;
+        }
+
+        std::atomic<long> _live{ 0 };
+    };
+
+    // over-aligned, so its future state bypasses the arenas
+    struct alignas(64) Wide {
+        long values[8];
+    };
+
+} // namespace
+
+int main() {
+    CountingResource upstream;
+
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        std::vector<TaskFuture<std::string>> strings;
+        std::vector<TaskFuture<Wide>> wides;
+        std::vector<Strand> strands;
+        {
+            ThreadPoolConfig config;
+            config.threads = 2;
+            config.mode = mode;
+            config.memory_resource = &upstream;
+            ThreadPool pool(config);
+
+            // allocated both outside the pool and on its workers, then freed after it is gone
+            for (int i = 0; i < 100; ++i) {
+                strings.push_back(spawn(pool, [i]() { return std::string(100, static_cast<char>('a' + i % 26)); }));
+                wides.push_back(spawn(pool, [i]() { return Wide{ { i, i, i, i, i, i, i, i } }; }));
+            }
+            spawn(pool,
+                  [&pool, &strings, &wides, &strands]() {
+                      strings.push_back(make_ready_future(pool, std::string(100, 'z')));
+                      wides.push_back(spawn(pool, []() { return Wide{ { 7, 7, 7, 7, 7, 7, 7, 7 } }; }));
+                      strands.emplace_back(pool);
+                  })
+                .get();
+            strands.emplace_back(pool);
+            for (const TaskFuture<std::string>& future : strings) {
+                future.wait();
+            }
+            for (const TaskFuture<Wide>& future : wides) {
+                future.wait();
+            }
+            // still queued on a strand and the timer queue when the pool goes
+            strands.back().post([]() {});
+            pool.schedule_after(std::chrono::hours(1), [payload = std::string(100, 't')]() {});
+        }
+
+        // the values still live in the closed arenas
+        long sum = 0;
+        for (const TaskFuture<std::string>& future : strings) {
+            sum += static_cast<long>(future.state()->value().size());
+        }
+        for (const TaskFuture<Wide>& future : wides) {
+            sum += future.state()->value().values[7];
+        }
+        if (sum != 101 * 100 + 99 * 100 / 2 + 7) {
+            std::printf("mode %d: values add up to %ld after the pool is gone\n", static_cast<int>(mode), sum);
+            ++failures;
+        }
+        // the over-aligned states go last, they alone have to keep the arenas alive
+        strings.clear();
+        strands.clear();
+        wides.clear();
+        if (upstream.live() != 0) {
+            std::printf("mode %d: %ld blocks never went back upstream\n", static_cast<int>(mode), upstream.live());
+            ++failures;
+        }
+    }
+
+    // a constructor that throws after the arenas exist gives them back
+    try {
+        ThreadPoolConfig config;
+        config.threads = 2;
+        config.mode = SchedulingMode::BOUNDED_QUEUE;
+        config.queue_capacity = 0;
+        config.memory_resource = &upstream;
+        ThreadPool pool(config);
+        std::printf("a BOUNDED_QUEUE pool without capacity was created\n");
+        ++failures;
+    } catch (const std::invalid_argument&) {
+    }
+    if (upstream.live() != 0) {
+        std::printf("failed constructor: %ld blocks never went back upstream\n", upstream.live());
+        ++failures;
+    }
+
+    if (failures == 0) {
+        std::printf("task memory: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
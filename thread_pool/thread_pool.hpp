@@ -1,102 +1,1946 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <ostream>
 #include <stdexcept>
+#include <stop_token>
+#include <system_error>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "cpu_topology.hpp"
+#include "inline_task.hpp"
+#include "mpmc_queue.hpp"
+#include "pool_stats.hpp"
+#include "priority_lanes.hpp"
+#include "task_memory.hpp"
+#include "timer_queue.hpp"
+#include "trace_ring.hpp"
+
+// how workers get their tasks
+enum class SchedulingMode : std::uint8_t {
+    // every task goes through one queue guarded by one mutex
+    SHARED_QUEUE,
+    // every worker owns a deque, idle workers steal from the others. tasks from outside
+    // the pool wait in one FIFO queue the workers check before they steal
+    WORK_STEALING,
+    // one fixed-size lock-free ring buffer, producers wait when it is full.
+    // tasks the workers submit go to their own deque instead, like in WORK_STEALING
+    BOUNDED_QUEUE
+};
+
+// what happens to enqueued tasks that sat in a queue for longer than queue_budget
+enum class OverloadPolicy : std::uint8_t {
+    // run every task, however long it waited
+    NONE,
+    // drop such a task when it comes up, its future reports std::future_errc::broken_promise
+    SHED,
+    // shed as well, and for one queue_budget after each shed task refuse new ones:
+    // enqueue throws and try_enqueue returns std::nullopt
+    REJECT
+};
+
+enum class ResizeKind : std::uint8_t {
+    GROW,
+    RETIRE
+};
+
+// reported by an elastic pool every time it adds or retires a worker
+struct ResizeEvent {
+    ResizeKind kind;
+    // worker count after the change
+    size_t threads;
+};
+
+struct ThreadPoolConfig {
+    size_t threads = std::thread::hardware_concurrency();
+    SchedulingMode mode = SchedulingMode::SHARED_QUEUE;
+    // ring buffer slots in BOUNDED_QUEUE mode, rounded up to a power of two. caps the
+    // tasks queued in the ring and the workers' deques together, a slot is reserved before
+    // a task is queued. only priority lane tasks (see post_with) and tasks of a worker
+    // nested MAX_HELP_DEPTH levels deep (see enqueue) go beyond it
+    size_t queue_capacity = 1024;
+
+    // elastic sizing, off while max_threads is 0. the pool starts with `threads` workers,
+    // adds one whenever a queued task has waited longer than grow_threshold and
+    // retires workers that found nothing to do for idle_timeout, down to min_threads
+    size_t min_threads = 0;
+    size_t max_threads = 0;
+    std::chrono::microseconds grow_threshold{ 1000 };
+    std::chrono::milliseconds idle_timeout{ 10000 };
+    // called on the supervisor or the retiring worker, keep it short
+    std::function<void(const ResizeEvent&)> on_resize;
+
+    // gets whatever a posted task throws, on the worker that ran it. without a hook the
+    // exception terminates the program, like one escaping a std::thread
+    std::function<void(std::exception_ptr)> on_exception;
+
+    // low-latency mode: an idle worker spins, then yields, for this long before it parks,
+    // and submitters skip the notify while a worker is spinning. 0 parks right away
+    std::chrono::microseconds spin_duration{ 0 };
+
+    // a BACKGROUND task (see post_with) that has waited this long runs ahead of everything else
+    std::chrono::milliseconds starvation_limit{ 100 };
+
+    // load shedding for tasks with a future (the enqueue family). posted tasks always run,
+    // Strand, TaskFuture and the parallel helpers rely on that
+    OverloadPolicy overload_policy = OverloadPolicy::NONE;
+    std::chrono::microseconds queue_budget{ 0 };
+
+    // worker i is pinned to cpu_affinity[i % cpu_affinity.size()] (Linux only).
+    // empty leaves placement to the OS
+    std::vector<int> cpu_affinity;
+    // NUMA-aware placement (Linux only): workers are spread over the nodes listed in /sys and
+    // pinned to their node's CPUs, or grouped by the node of their cpu_affinity core.
+    // SHARED_QUEUE then keeps one queue per node, and idle workers steal from their own node first
+    bool numa_aware = false;
+
+    // upstream of per-worker arenas for task memory: closures too big for InlineTask,
+    // future shared states, TaskFuture and Strand nodes. a worker allocates from its own
+    // arena without locking, and memory freed on another thread goes back to its arena
+    // through a lock-free list. submitters outside the pool allocate from the upstream directly.
+    // must be thread-safe: every arena refills from it and outside threads allocate from it, all
+    // at the same time, so use std::pmr::new_delete_resource() or a synchronized_pool_resource,
+    // never an unsynchronized one. nullptr keeps everything on the global heap. must outlive
+    // every future and strand of the pool
+    std::pmr::memory_resource* memory_resource = nullptr;
+
+    // task spans kept per worker for write_trace(), the oldest are overwritten. 0 turns tracing off
+    size_t trace_capacity = 0;
+};
+
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t threads);
+    explicit ThreadPool(const ThreadPoolConfig& config);
+    explicit ThreadPool(size_t threads, SchedulingMode mode = SchedulingMode::SHARED_QUEUE);
 
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
 
+    // fire and forget: runs f(args...) with no future and no shared state, so small callables
+    // don't allocate at all. exceptions go to ThreadPoolConfig::on_exception.
+    // in BOUNDED_QUEUE mode this waits while the queue is full, see enqueue
+    template <typename F, typename... Args>
+    void post(F&& f, Args&&... args);
+
+    // like post, but returns false instead of waiting when the queue is full
+    template <typename F, typename... Args>
+    auto try_post(F&& f, Args&&... args) -> bool;
+
+    // like post, as a HIGH, NORMAL or BACKGROUND task and optionally with a deadline.
+    // HIGH tasks and tasks with a deadline skip the worker deques and the ring buffer for a set
+    // of priority lanes the workers look at first; BACKGROUND tasks run when nothing else is
+    // queued. in BOUNDED_QUEUE mode lane tasks count against queue_capacity but never wait
+    template <typename F, typename... Args>
+    void post_with(const TaskOptions& options, F&& f, Args&&... args);
+
+    template <typename F, typename... Args>
+    auto enqueue_with(const TaskOptions& options, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    // blocks until every task submitted so far, and everything they submitted, has finished.
+    // can't be called from one of the pool's own workers
+    void wait_idle();
+
+    // runs one queued task on the calling thread, false if there was none
+    auto try_run_one() -> bool;
+
+    // waits until ready() returns true. on one of our workers it runs queued tasks
+    // meanwhile, so tasks waiting for their own subtasks can't deadlock the pool;
+    // block(timeout) should wait for readiness for at most timeout when there's nothing to run.
+    // a worker helps with the newest tasks, the ones most likely to be the subtasks it waits
+    // for, and never more than MAX_HELP_DEPTH levels deep on its own stack: past that a
+    // temporary thread stands in for it and helps on a fresh stack while the worker sleeps,
+    // so chains of nested waits of any depth finish, even on a single worker
+    template <typename Ready, typename Block>
+    void help_until(Ready ready, Block block);
+
+    // future.wait() and future.get() that help out while waiting, see help_until
+    template <typename T>
+    void help_wait(const std::future<T>& future);
+
+    template <typename T>
+    auto help_get(std::future<T>& future) -> T;
+
+    // in BOUNDED_QUEUE mode this waits while the queue is full. one of the pool's own workers
+    // doesn't wait, every worker could end up waiting for space: it runs the task itself
+    // before returning (counted as WorkerStatsSnapshot::inline_runs), or, once it is nested
+    // MAX_HELP_DEPTH levels deep, queues it on its own deque beyond queue_capacity
     template <typename F, typename... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
 
+    // like enqueue, but dropped before it starts once token is stopped, and its future reports
+    // std::future_errc::broken_promise. f can watch the same token to stop early while it runs.
+    // hand one std::stop_source's token to many tasks to cancel all of them at once
+    template <typename F, typename... Args>
+    auto enqueue(std::stop_token token, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    // like enqueue, but returns std::nullopt instead of waiting when the queue is full.
+    // only BOUNDED_QUEUE can be full, the other modes always accept the task
+    template <typename F, typename... Args>
+    auto try_enqueue(F&& f, Args&&... args) -> std::optional<std::future<std::invoke_result_t<F, Args...>>>;
+
+    // submit every callable in [first, last) under one lock acquisition per queue
+    template <typename InputIt>
+    auto enqueue_bulk(InputIt first, InputIt last)
+        -> std::vector<std::future<std::invoke_result_t<typename std::iterator_traits<InputIt>::reference>>>;
+
+    // submit count tasks, task i runs f(i)
+    template <typename F>
+    auto enqueue_bulk(size_t count, F f) -> std::vector<std::future<std::invoke_result_t<F&, size_t>>>;
+
+    // like enqueue, but queued close to the given NUMA node or worker: on the node's queue, or
+    // on the worker's own deque in WORK_STEALING mode. idle workers elsewhere may still steal it.
+    // pools with a single queue (plain SHARED_QUEUE, BOUNDED_QUEUE) ignore the hint.
+    // node is the kernel's node number, one of node_ids()
+    template <typename F, typename... Args>
+    auto enqueue_on_node(size_t node, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    template <typename F, typename... Args>
+    auto enqueue_on_worker(size_t worker, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    using TimerId = TimerQueue::TimerId;
+
+    // posts f once delay has passed. all timers of a pool share one timer thread,
+    // started by the first call, which only moves due tasks onto the queues. it never waits
+    // for a full BOUNDED_QUEUE ring, due tasks that don't fit go to the priority lanes
+    template <typename F>
+    auto schedule_after(std::chrono::steady_clock::duration delay, F&& f) -> TimerId;
+
+    // posts f every period, the first time one period from now. the next run is only
+    // armed once the previous one finished, so runs never overlap and late periods are skipped
+    template <typename F>
+    auto schedule_every(std::chrono::steady_clock::duration period, F&& f) -> TimerId;
+
+    // false if the timer already fired, or was cancelled before.
+    // a periodic run that is already queued still happens
+    auto cancel_timer(TimerId id) -> bool;
+
+    class ScheduleAwaiter;
+
+    // co_await pool.schedule() resumes the awaiting coroutine on one of the workers
+    auto schedule() -> ScheduleAwaiter;
+
+    // current number of workers, changes over time in an elastic pool
+    [[nodiscard]] auto size() const -> size_t { return _active_workers.load(std::memory_order_relaxed); }
+    [[nodiscard]] auto mode() const -> SchedulingMode { return _mode; }
+    [[nodiscard]] auto elastic() const -> bool { return _elastic; }
+    [[nodiscard]] auto grow_count() const -> size_t { return _grow_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] auto retire_count() const -> size_t { return _retire_count.load(std::memory_order_relaxed); }
+    // tasks dropped because their stop_token was stopped, because they waited past
+    // queue_budget, and tasks refused by OverloadPolicy::REJECT
+    [[nodiscard]] auto cancelled_count() const -> size_t { return _cancelled_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] auto shed_count() const -> size_t { return _shed_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] auto rejected_count() const -> size_t { return _rejected_count.load(std::memory_order_relaxed); }
+    // 1 unless the pool is numa_aware
+    [[nodiscard]] auto node_count() const -> size_t { return _node_workers.size(); }
+    // the kernel's numbers of the nodes with CPUs, as in /sys/devices/system/node/node<n>.
+    // they can have gaps where memory-only nodes are. just { 0 } unless the pool is numa_aware
+    [[nodiscard]] auto node_ids() const -> const std::vector<int>& { return _node_ids; }
+    // the kernel's number of the worker's node
+    [[nodiscard]] auto worker_node(size_t worker) const -> size_t {
+        return static_cast<size_t>(_node_ids[_worker_node.at(worker)]);
+    }
+    // the worker arenas TaskFuture and Strand allocate from too, nullptr without a memory_resource
+    [[nodiscard]] auto memory_resource() const -> std::pmr::memory_resource* { return _task_memory; }
+
+    // counters and latency histograms, empty unless built with THREAD_POOL_INSTRUMENTATION.
+    // a worker's idle time is added up when it picks up its next task
+    [[nodiscard]] auto stats() const -> ThreadPoolStats;
+
+    // the tasks each worker ran recently, as Chrome trace-event JSON that opens in Perfetto or
+    // chrome://tracing. empty without trace_capacity. workers write their spans without
+    // synchronization, so call it while the pool is idle, e.g. after wait_idle()
+    void write_trace(std::ostream& out) const;
+
     ~ThreadPool();
 
+    // nested help_until calls a worker makes on its own stack before a stand-in thread takes
+    // over (see help_until), each level keeps the waiting task's frames on the stack. tasks a
+    // worker runs inline because the BOUNDED_QUEUE ring is full count as levels too
+    static constexpr size_t MAX_HELP_DEPTH = 64;
+
 private:
-    // need to keep track of threads so we can join them
-    std::vector<std::thread> _workers;
-    // the task queue
-    std::queue<std::function<void()>> _tasks;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // per-worker deque, the owner works on the back and thieves take from the front
+    struct alignas(CACHE_LINE_SIZE) WorkerQueue {
+        std::mutex mutex;
+        std::deque<InlineTask> tasks;
+    };
+
+    // a retired worker leaves its slot inactive, the thread is joined when the slot is reused
+    struct WorkerSlot {
+        std::thread thread;
+        bool active = false;
+    };
+
+    // where push_task queues a task, see enqueue_on_node and enqueue_on_worker
+    struct Placement {
+        enum class Kind : std::uint8_t {
+            ANY,
+            NODE,
+            WORKER
+        };
+        Kind kind;
+        size_t index;
+    };
+
+    // one more level of tasks run on top of a task still on the stack, see MAX_HELP_DEPTH
+    struct NestedRun {
+        NestedRun() { ++_help_depth; }
+        ~NestedRun() { --_help_depth; }
+
+        NestedRun(const NestedRun&) = delete;
+        NestedRun& operator=(const NestedRun&) = delete;
+    };
+
+    template <typename F, typename... Args>
+    static auto make_task(F&& f, Args&&... args) -> std::packaged_task<std::invoke_result_t<F, Args...>()>;
+    template <typename F, typename... Args>
+    static auto make_job(F&& f, Args&&... args);
+    template <typename F>
+    auto make_inline(F&& f) -> InlineTask;
+    template <typename F, typename... Args>
+    auto package(std::stop_token token, F&& f, Args&&... args)
+        -> std::pair<InlineTask, std::future<std::invoke_result_t<F, Args...>>>;
+    template <typename Job>
+    auto guard(std::stop_token token, bool sheddable, Job job) -> InlineTask;
+    auto should_drop(const std::stop_token& token, bool shed, std::chrono::steady_clock::time_point queued_at) -> bool;
+    auto overloaded() const -> bool;
+    void reject_if_overloaded();
+
+    void place_workers(const ThreadPoolConfig& config, size_t slots);
+    void start_worker(size_t index);
+    void worker_main(size_t index);
+    void enter_worker(size_t index);
+    template <typename Ready, typename Block>
+    void help_on_stand_in(Ready& ready, Block& block);
+    void shared_queue_loop(size_t index);
+    void work_stealing_loop(size_t index);
+    void bounded_queue_loop(size_t index);
+    auto wait_for_pending(size_t index) -> bool;
+    template <typename Predicate>
+    auto park(std::unique_lock<std::mutex>& lock, Predicate predicate) -> bool;
+    auto spin_for_work() -> bool;
+    static void cpu_relax();
+    void note_dequeue();
+    auto take_task(InlineTask& task, TaskPriority& priority) -> bool;
+    auto help_one() -> bool;
+    auto pop_shared(InlineTask& task, TaskPriority& priority, bool newest = false) -> bool;
+    auto pop_lane_task(bool urgent, InlineTask& task, TaskPriority& priority) -> bool;
+    void run_task(size_t index, InlineTask& task, TaskPriority priority = TaskPriority::NORMAL);
+    void invoke(InlineTask& task);
+    void finish_task();
+    void trace_span(size_t index, std::chrono::steady_clock::time_point begin, TaskPriority priority, bool helping);
+    static void stamp(InlineTask& task);
+    void add_pending(size_t count);
+    auto reserve_slot() -> bool;
+    void note_queue_depth(size_t pending);
+    void note_steal(size_t index);
+    void note_inline_run(size_t index);
+
+    auto timers() -> TimerQueue&;
+    void dispatch_timer(InlineTask task);
+
+    void supervisor_loop();
+    auto grow() -> bool;
+    auto try_retire(size_t index) -> bool;
+    void report_resize(ResizeKind kind, size_t threads);
+
+    void push_task(InlineTask task, Placement placement = Placement{ Placement::Kind::ANY, 0 });
+    auto push_local(InlineTask& task, bool beyond_capacity = false) -> bool;
+    void push_prioritized(const TaskOptions& options, InlineTask task);
+    auto pick_queue(Placement placement) -> size_t;
+    void push_tasks(std::vector<InlineTask>& tasks);
+    void wake_workers(size_t count);
+    auto try_push_bounded(InlineTask& task) -> bool;
+    auto push_bounded(InlineTask& task) -> bool;
+    void release_slot();
+    auto pop_local_task(size_t index, InlineTask& task, bool newest = false) -> bool;
+    auto steal_task(size_t index, InlineTask& task) -> bool;
+    auto pop_injected(InlineTask& task) -> bool;
+    void note_taken();
+
+    // need to keep track of threads so we can join them.
+    // one slot per possible worker, guarded by _workers_mutex
+    std::vector<WorkerSlot> _workers;
+    std::mutex _workers_mutex;
+    std::atomic<size_t> _active_workers{ 0 };
+    // the task queue, FIFO for the workers' loops. helpers take the newest task
+    std::deque<InlineTask> _tasks;
+
+    // one deque per worker in WORK_STEALING and BOUNDED_QUEUE mode, one per node in a
+    // numa_aware SHARED_QUEUE pool
+    SchedulingMode _mode;
+    std::vector<WorkerQueue> _worker_queues;
+    // WORK_STEALING: tasks submitted from outside the pool, FIFO so the oldest of them can't
+    // starve behind newer ones. workers look here after their own deque, before stealing
+    WorkerQueue _injected;
+    bool _per_node_queues = false;
+    // per worker slot: its node, the CPUs it is pinned to (empty for none), the queue it
+    // takes from first and the order it steals from the others in, same node first.
+    // nodes are numbered densely here, _node_ids maps them to the kernel's numbers
+    std::vector<size_t> _worker_node;
+    std::vector<std::vector<int>> _worker_cpus;
+    std::vector<size_t> _home_queue;
+    std::vector<std::vector<size_t>> _steal_order;
+    // the worker slots of every node
+    std::vector<std::vector<size_t>> _node_workers;
+    std::vector<int> _node_ids;
+    // the ring buffer, only used in BOUNDED_QUEUE mode
+    std::unique_ptr<MpmcQueue<InlineTask>> _ring;
+    // tasks sitting in any of the queues.
+    // raised before a task is published and lowered after it is taken, so it never undercounts
+    std::atomic<size_t> _pending{ 0 };
+    // workers waiting on _condition, used to skip the notify when nobody sleeps
+    std::atomic<size_t> _sleeping{ 0 };
+    // workers polling _pending before they park, they need no notify at all
+    std::atomic<size_t> _spinning{ 0 };
+    std::chrono::microseconds _spin_duration{ 0 };
+    // round-robin cursor for tasks submitted from outside the pool
+    std::atomic<size_t> _next_queue{ 0 };
+
+    // HIGH, BACKGROUND and deadline tasks. guarded by _queue_mutex in a single-queue
+    // SHARED_QUEUE pool, so its workers see them in the same place as _tasks, else by _lanes_mutex
+    PriorityLanes _lanes;
+    std::mutex _lanes_mutex;
 
     // synchronization
     std::mutex _queue_mutex;
     std::condition_variable _condition;
-    bool _stop{ false };
+    std::atomic<bool> _stop{ false };
+
+    // elastic sizing. the supervisor samples _pending and _dequeued every grow_threshold
+    bool _elastic = false;
+    size_t _min_threads = 0;
+    std::chrono::microseconds _grow_threshold{ 0 };
+    std::chrono::milliseconds _idle_timeout{ 0 };
+    std::function<void(const ResizeEvent&)> _on_resize;
+    std::function<void(std::exception_ptr)> _on_exception;
+    std::atomic<size_t> _dequeued{ 0 };
+    std::atomic<size_t> _grow_count{ 0 };
+    std::atomic<size_t> _retire_count{ 0 };
+
+    // cancellation and load shedding, see OverloadPolicy
+    OverloadPolicy _overload_policy = OverloadPolicy::NONE;
+    std::chrono::microseconds _queue_budget{ 0 };
+    // REJECT refuses tasks until then, in steady_clock ticks
+    std::atomic<std::chrono::steady_clock::rep> _overloaded_until{ 0 };
+    std::atomic<size_t> _cancelled_count{ 0 };
+    std::atomic<size_t> _shed_count{ 0 };
+    std::atomic<size_t> _rejected_count{ 0 };
+    std::thread _supervisor;
+    std::mutex _supervisor_mutex;
+    std::condition_variable _supervisor_condition;
+
+    // producers waiting for a free ring buffer slot
+    std::mutex _space_mutex;
+    std::condition_variable _space_condition;
+    std::atomic<size_t> _waiting_producers{ 0 };
+
+    // tasks queued or running, raised together with _pending and lowered after the task ran
+    std::atomic<size_t> _unfinished{ 0 };
+    std::mutex _idle_mutex;
+    std::condition_variable _idle_condition;
+    std::atomic<size_t> _idle_waiters{ 0 };
+
+    // created by the first schedule_after/schedule_every
+    std::unique_ptr<TimerQueue> _timers;
+    std::once_flag _timers_once;
+    // set once _timers exists, so cancel_timer doesn't start a timer thread
+    std::atomic<bool> _timers_started{ false };
+
+    // the worker arenas, nullptr without a memory_resource. closed rather than deleted,
+    // it lives on until the last block handed out is freed
+    TaskMemory* _task_memory = nullptr;
+
+    // one ring of task spans per worker slot, nullptr unless tracing
+    std::unique_ptr<TraceRing[]> _trace;
+    std::chrono::steady_clock::time_point _trace_epoch;
+
+#if THREAD_POOL_INSTRUMENTATION
+    // one set of counters per worker slot, written only by that worker
+    std::unique_ptr<stats_detail::WorkerCounters[]> _counters;
+    std::atomic<size_t> _queue_high_water{ 0 };
+#endif
+
+    // the pool and worker index of the calling thread, if it is a worker
+    inline static thread_local ThreadPool* _current_pool = nullptr;
+    inline static thread_local size_t _current_index = 0;
+    // help_until calls the calling thread is nested in
+    inline static thread_local size_t _help_depth = 0;
+};
+
+class ThreadPool::ScheduleAwaiter {
+public:
+    explicit ScheduleAwaiter(ThreadPool& pool)
+        : _pool(pool) {}
+
+    [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+
+    // the handle fits in InlineTask, so hopping onto the pool doesn't allocate
+    void await_suspend(std::coroutine_handle<> handle) {
+        _pool.push_task([handle]() { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    ThreadPool& _pool;
 };
 
+inline auto ThreadPool::schedule() -> ScheduleAwaiter {
+    return ScheduleAwaiter(*this);
+}
+
 // the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads) {
-    for (size_t i = 0; i < threads; ++i) {
-        _workers.emplace_back(
-            [this]() {
-                while (true) {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->_queue_mutex);
-                        this->_condition.wait(
-                            lock,
-                            [this]() -> bool {
-                                return this->_stop || !this->_tasks.empty();
-                            });
-                        if (this->_stop && this->_tasks.empty()) {
-                            return;
-                        }
-                        task = std::move(this->_tasks.front());
-                        this->_tasks.pop();
-                    }
-
-                    task();
+inline ThreadPool::ThreadPool(const ThreadPoolConfig& config)
+    : _mode(config.mode),
+      _spin_duration(config.spin_duration),
+      _lanes(config.starvation_limit),
+      _elastic(config.max_threads > 0),
+      _min_threads(config.min_threads),
+      _grow_threshold(config.grow_threshold),
+      _idle_timeout(config.idle_timeout),
+      _on_resize(config.on_resize),
+      _on_exception(config.on_exception),
+      _overload_policy(config.overload_policy),
+      _queue_budget(config.queue_budget) {
+    const size_t slots = _elastic ? config.max_threads : config.threads;
+    if (_elastic && (config.min_threads > config.threads || config.threads > config.max_threads)) {
+        throw std::invalid_argument("elastic ThreadPool needs min_threads <= threads <= max_threads");
+    }
+    if (_mode == SchedulingMode::WORK_STEALING && slots == 0) {
+        throw std::invalid_argument("work stealing ThreadPool needs at least one thread");
+    }
+    place_workers(config, slots);
+    // workers bind to the arenas as they start, but the pool only takes the memory over
+    // at the end: if anything below throws, the guard deletes it, nothing was handed out yet
+    std::unique_ptr<TaskMemory> task_memory;
+    if (config.memory_resource != nullptr) {
+        task_memory = std::make_unique<TaskMemory>(config.memory_resource, slots);
+        _task_memory = task_memory.get();
+    }
+    if (_mode == SchedulingMode::BOUNDED_QUEUE) {
+        _ring = std::make_unique<MpmcQueue<InlineTask>>(config.queue_capacity);
+    }
+
+    _workers.resize(slots);
+    if (config.trace_capacity > 0) {
+        _trace = std::make_unique<TraceRing[]>(slots);
+        for (size_t i = 0; i < slots; ++i) {
+            _trace[i].reserve(config.trace_capacity);
+        }
+        _trace_epoch = std::chrono::steady_clock::now();
+    }
+#if THREAD_POOL_INSTRUMENTATION
+    _counters = std::make_unique<stats_detail::WorkerCounters[]>(slots);
+#endif
+    {
+        std::unique_lock<std::mutex> lock(_workers_mutex);
+        for (size_t i = 0; i < config.threads; ++i) {
+            start_worker(i);
+        }
+    }
+
+    if (_elastic) {
+        _supervisor = std::thread([this]() { this->supervisor_loop(); });
+    }
+    task_memory.release();
+}
+
+inline ThreadPool::ThreadPool(size_t threads, SchedulingMode mode)
+    : ThreadPool(
+          [threads, mode]() {
+              ThreadPoolConfig config;
+              config.threads = threads;
+              config.mode = mode;
+              return config;
+          }()) {}
+
+// decides every slot's node, CPUs, home queue and steal order before any worker starts
+inline void ThreadPool::place_workers(const ThreadPoolConfig& config, size_t slots) {
+    const CpuTopology topology = config.numa_aware ? CpuTopology::detect() : CpuTopology{};
+    const size_t nodes = config.numa_aware ? topology.nodes.size() : 1;
+
+    _node_ids = config.numa_aware ? topology.ids : std::vector<int>{ 0 };
+    _worker_node.assign(slots, 0);
+    _worker_cpus.assign(slots, {});
+    _node_workers.assign(nodes, {});
+    for (size_t i = 0; i < slots; ++i) {
+        if (!config.cpu_affinity.empty()) {
+            const int cpu = config.cpu_affinity[i % config.cpu_affinity.size()];
+            _worker_cpus[i] = { cpu };
+            if (config.numa_aware) {
+                _worker_node[i] = topology.node_of_cpu(cpu);
+            }
+        } else if (config.numa_aware) {
+            _worker_node[i] = i % nodes;
+            _worker_cpus[i] = topology.nodes[_worker_node[i]];
+        }
+        _node_workers[_worker_node[i]].push_back(i);
+    }
+
+    std::vector<size_t> queue_node;
+    _per_node_queues = config.numa_aware && _mode == SchedulingMode::SHARED_QUEUE;
+    if (_mode == SchedulingMode::WORK_STEALING || _mode == SchedulingMode::BOUNDED_QUEUE) {
+        _worker_queues = std::vector<WorkerQueue>(slots);
+        queue_node = _worker_node;
+        for (size_t i = 0; i < slots; ++i) {
+            _home_queue.push_back(i);
+        }
+    } else if (_per_node_queues) {
+        _worker_queues = std::vector<WorkerQueue>(nodes);
+        for (size_t node = 0; node < nodes; ++node) {
+            queue_node.push_back(node);
+        }
+        _home_queue = _worker_node;
+    } else {
+        return;
+    }
+
+    // each group in round-robin order from the home queue, so thieves don't all pick the same victim
+    const size_t queues = _worker_queues.size();
+    _steal_order.assign(slots, {});
+    for (size_t i = 0; i < slots; ++i) {
+        for (const bool local : { true, false }) {
+            for (size_t offset = 1; offset < queues; ++offset) {
+                const size_t victim = (_home_queue[i] + offset) % queues;
+                if ((queue_node[victim] == _worker_node[i]) == local) {
+                    _steal_order[i].push_back(victim);
                 }
-            });
+            }
+        }
     }
 }
 
-// add new work item to the pool
-template <typename F, typename... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
-    using return_type = std::invoke_result_t<F, Args...>;
+// needs _workers_mutex
+inline void ThreadPool::start_worker(size_t index) {
+    WorkerSlot& slot = _workers[index];
+    if (slot.thread.joinable()) {
+        slot.thread.join();
+    }
+    slot.active = true;
+    _active_workers.fetch_add(1, std::memory_order_relaxed);
+    slot.thread = std::thread([this, index]() { this->worker_main(index); });
+}
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        [f = std::forward<F>(f), args...]() -> return_type {
-            return std::invoke(f, args...);
+inline void ThreadPool::worker_main(size_t index) {
+    enter_worker(index);
+#if THREAD_POOL_INSTRUMENTATION
+    _counters[index].last_end = std::chrono::steady_clock::now();
+#endif
+
+    switch (_mode) {
+        case SchedulingMode::SHARED_QUEUE:
+            if (_per_node_queues) {
+                work_stealing_loop(index);
+            } else {
+                shared_queue_loop(index);
+            }
+            break;
+        case SchedulingMode::WORK_STEALING: work_stealing_loop(index); break;
+        case SchedulingMode::BOUNDED_QUEUE: bounded_queue_loop(index); break;
+    }
+
+    // the loops only return early when the worker retired. report it here,
+    // where no pool lock is held and the callback may submit work
+    if (!_stop.load()) {
+        report_resize(ResizeKind::RETIRE, size());
+    }
+}
+
+// makes the calling thread worker index: its queues, arena and CPUs
+inline void ThreadPool::enter_worker(size_t index) {
+    _current_pool = this;
+    _current_index = index;
+    if (_task_memory != nullptr) {
+        _task_memory->bind(index);
+    }
+    if (!_worker_cpus[index].empty()) {
+        // best effort, a CPU outside our cpuset just leaves the worker unpinned
+        pin_current_thread(_worker_cpus[index]);
+    }
+}
+
+inline void ThreadPool::shared_queue_loop(size_t index) {
+    while (true) {
+        InlineTask task;
+        TaskPriority priority = TaskPriority::NORMAL;
+
+        if (_pending.load() == 0) {
+            spin_for_work();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(this->_queue_mutex);
+            const bool ready = park(
+                lock,
+                [this]() -> bool {
+                    return this->_stop || !this->_tasks.empty() || !this->_lanes.empty();
+                });
+            if (!ready) {
+                if (try_retire(index)) {
+                    return;
+                }
+                continue;
+            }
+            // nothing left means we are stopping
+            if (!pop_shared(task, priority)) {
+                return;
+            }
+        }
+
+        run_task(index, task, priority);
+    }
+}
+
+// also serves the node queues of a numa_aware SHARED_QUEUE pool
+inline void ThreadPool::work_stealing_loop(size_t index) {
+    while (true) {
+        InlineTask task;
+        TaskPriority priority = TaskPriority::NORMAL;
+
+        if (pop_lane_task(true, task, priority) || pop_local_task(index, task) || pop_injected(task)
+            || steal_task(index, task) || pop_lane_task(false, task, priority)) {
+            run_task(index, task, priority);
+            continue;
+        }
+
+        if (!wait_for_pending(index)) {
+            return;
+        }
+    }
+}
+
+// the worker's own deque first, then the ring, then the other workers' deques
+inline void ThreadPool::bounded_queue_loop(size_t index) {
+    while (true) {
+        InlineTask task;
+        TaskPriority priority = TaskPriority::NORMAL;
+
+        if (pop_lane_task(true, task, priority)) {
+            run_task(index, task, priority);
+            continue;
+        }
+        if (pop_local_task(index, task)) {
+            run_task(index, task);
+            continue;
+        }
+        if (_ring->try_pop(task)) {
+            release_slot();
+            run_task(index, task);
+            continue;
+        }
+        if (steal_task(index, task) || pop_lane_task(false, task, priority)) {
+            run_task(index, task, priority);
+            continue;
+        }
+
+        if (!wait_for_pending(index)) {
+            return;
+        }
+    }
+}
+
+// park until a submitter bumps _pending, returns false once the pool is stopped and drained
+// or the worker retired. _sleeping is raised before _pending is re-checked so a submitter
+// either sees us sleeping or we see its task
+inline auto ThreadPool::wait_for_pending(size_t index) -> bool {
+    if (spin_for_work()) {
+        return !_stop || _pending.load() > 0;
+    }
+
+    std::unique_lock<std::mutex> lock(_queue_mutex);
+    _sleeping.fetch_add(1);
+    const bool ready = park(
+        lock,
+        [this]() -> bool {
+            return _stop || _pending.load() > 0;
         });
+    _sleeping.fetch_sub(1);
+    if (!ready) {
+        return !try_retire(index);
+    }
+    return !_stop || _pending.load() > 0;
+}
 
-    std::future<return_type> res = task->get_future();
-    {
+// waits on _condition, for at most idle_timeout in an elastic pool.
+// returns the predicate, so false means the worker was idle for the whole timeout
+template <typename Predicate>
+auto ThreadPool::park(std::unique_lock<std::mutex>& lock, Predicate predicate) -> bool {
+    if (!_elastic) {
+        _condition.wait(lock, predicate);
+        return true;
+    }
+    return _condition.wait_for(lock, _idle_timeout, predicate);
+}
+
+// low-latency mode: poll _pending for up to spin_duration, true if work showed up.
+// _spinning is lowered before the caller re-checks under _queue_mutex, so a submitter
+// that skipped the notify because we were spinning is always seen on the way to park
+inline auto ThreadPool::spin_for_work() -> bool {
+    if (_spin_duration.count() == 0) {
+        return false;
+    }
+
+    _spinning.fetch_add(1);
+    const auto deadline = std::chrono::steady_clock::now() + _spin_duration;
+    bool found = false;
+    for (unsigned spins = 1;; ++spins) {
+        if (_pending.load() > 0 || _stop.load()) {
+            found = true;
+            break;
+        }
+        if (spins % 64 == 0) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            std::this_thread::yield();
+        } else {
+            cpu_relax();
+        }
+    }
+    _spinning.fetch_sub(1);
+
+    // submitters didn't notify anyone for us, pass the extra work on
+    if (found && _pending.load() > 1) {
+        wake_workers(1);
+    }
+    return found;
+}
+
+inline void ThreadPool::cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// only the supervisor reads _dequeued, so fixed-size pools skip the shared counter
+inline void ThreadPool::note_dequeue() {
+    if (_elastic) {
+        _dequeued.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// takes a queued task for a thread that would otherwise wait. a worker is nested inside a
+// task that waits, so it takes the newest task, which is most likely what it waits for and
+// least likely to wait in turn: the back of the shared queue or of its own deque. the
+// BOUNDED_QUEUE ring, the oldest tasks of all, comes last, it may hold what every worker
+// waits for
+inline auto ThreadPool::take_task(InlineTask& task, TaskPriority& priority) -> bool {
+    const bool from_worker = _current_pool == this;
+    if (_mode == SchedulingMode::SHARED_QUEUE && !_per_node_queues) {
         std::unique_lock<std::mutex> lock(_queue_mutex);
+        return pop_shared(task, priority, from_worker);
+    }
+
+    if (pop_lane_task(true, task, priority)) {
+        return true;
+    }
+
+    if (from_worker && (pop_local_task(_current_index, task, true) || steal_task(_current_index, task))) {
+        return true;
+    }
+
+    if (pop_injected(task)) {
+        return true;
+    }
+
+    if (_mode == SchedulingMode::BOUNDED_QUEUE && _ring->try_pop(task)) {
+        release_slot();
+        return true;
+    }
+
+    if (from_worker) {
+        return pop_lane_task(false, task, priority);
+    }
+    const size_t queues = _worker_queues.size();
+    const size_t first_queue = _next_queue.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < queues; ++i) {
+        WorkerQueue& queue = _worker_queues[(first_queue + i) % queues];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            note_taken();
+            return true;
+        }
+    }
+    return pop_lane_task(false, task, priority);
+}
+
+// needs _queue_mutex. the next task of a single-queue SHARED_QUEUE pool: urgent lane tasks,
+// then the oldest (or newest) of _tasks, then BACKGROUND. false if there is none
+inline auto ThreadPool::pop_shared(InlineTask& task, TaskPriority& priority, bool newest) -> bool {
+    if (_lanes.empty() || !_lanes.pop_urgent(!_tasks.empty(), task, priority)) {
+        if (!_tasks.empty()) {
+            if (newest) {
+                task = std::move(_tasks.back());
+                _tasks.pop_back();
+            } else {
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+        } else if (_lanes.empty() || !_lanes.pop_background(task, priority)) {
+            return false;
+        }
+    }
+    _pending.fetch_sub(1);
+    return true;
+}
+
+// the lanes' part of a worker's search in pools with more than one queue: urgent tasks
+// come before the worker's own queues, BACKGROUND ones after everything else
+inline auto ThreadPool::pop_lane_task(bool urgent, InlineTask& task, TaskPriority& priority) -> bool {
+    if (_lanes.empty()) {
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock(_lanes_mutex);
+        const bool popped = urgent ? _lanes.pop_urgent(_pending.load() > _lanes.size(), task, priority)
+                                   : _lanes.pop_background(task, priority);
+        if (!popped) {
+            return false;
+        }
+    }
+    note_taken();
+    return true;
+}
+
+// not timed on its own when instrumented: a worker helping out while it waits
+// counts the time as busy time of the task that waits
+inline auto ThreadPool::try_run_one() -> bool {
+    InlineTask task;
+    TaskPriority priority = TaskPriority::NORMAL;
+    if (!take_task(task, priority)) {
+        return false;
+    }
+    const bool traced = _trace != nullptr && _current_pool == this;
+    const auto traced_at = traced ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    note_dequeue();
+    invoke(task);
+    if (traced) {
+        trace_span(_current_index, traced_at, priority, true);
+    }
+    finish_task();
+    return true;
+}
+
+// try_run_one, counted as one more level of helping
+inline auto ThreadPool::help_one() -> bool {
+    const NestedRun nested;
+    return try_run_one();
+}
+
+template <typename Ready, typename Block>
+void ThreadPool::help_until(Ready ready, Block block) {
+    constexpr std::chrono::microseconds FIRST_BACKOFF{ 1 };
+    constexpr std::chrono::microseconds MAX_BACKOFF{ 500 };
+
+    if (_current_pool != this) {
+        while (!ready()) {
+            block(std::chrono::milliseconds(10));
+        }
+        return;
+    }
+    if (_help_depth >= MAX_HELP_DEPTH) {
+        help_on_stand_in(ready, block);
+        return;
+    }
+
+    // block() returns as soon as we're ready, the backoff only bounds how late we notice new tasks
+    std::chrono::microseconds backoff = FIRST_BACKOFF;
+    while (!ready()) {
+        if (help_one()) {
+            backoff = FIRST_BACKOFF;
+            continue;
+        }
+        block(backoff);
+        backoff = std::min(backoff * 2, MAX_BACKOFF);
+    }
+}
+
+// the worker's stack is used up, but just blocking could deadlock the pool when the levels
+// below wait for tasks only this worker would get to. a temporary thread becomes the same
+// worker, with its deque, arena and counters, and helps on a fresh stack. the worker sleeps
+// in join() meanwhile, so there is still only one owner of each
+template <typename Ready, typename Block>
+void ThreadPool::help_on_stand_in(Ready& ready, Block& block) {
+    const size_t index = _current_index;
+    std::exception_ptr error;
+    std::thread stand_in;
+    try {
+        stand_in = std::thread([this, index, &ready, &block, &error]() {
+            enter_worker(index);
+            try {
+                help_until(ready, block);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        });
+    } catch (const std::system_error&) {
+        // out of threads, block and hope another worker gets to it
+        while (!ready()) {
+            block(std::chrono::milliseconds(10));
+        }
+        return;
+    }
+    stand_in.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename T>
+void ThreadPool::help_wait(const std::future<T>& future) {
+    if (_current_pool != this) {
+        future.wait();
+        return;
+    }
+    help_until(
+        [&future]() -> bool {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        },
+        [&future](std::chrono::microseconds timeout) { future.wait_for(timeout); });
+}
+
+template <typename T>
+auto ThreadPool::help_get(std::future<T>& future) -> T {
+    help_wait(future);
+    return future.get();
+}
+
+// runs a task the worker just took off a queue, timing it when instrumented
+inline void ThreadPool::run_task(size_t index, InlineTask& task, TaskPriority priority) {
+    note_dequeue();
+    const auto traced_at = _trace != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+#if THREAD_POOL_INSTRUMENTATION
+    stats_detail::WorkerCounters& counters = _counters[index];
+    const auto start = std::chrono::steady_clock::now();
+    counters.queue_wait.record(start - task.queued_at());
+    counters.queue_wait_by_priority[static_cast<size_t>(priority)].record(start - task.queued_at());
+    stats_detail::bump(counters.idle_ns, static_cast<uint64_t>((start - counters.last_end).count()));
+
+    invoke(task);
+
+    const auto end = std::chrono::steady_clock::now();
+    counters.execution.record(end - start);
+    stats_detail::bump(counters.busy_ns, static_cast<uint64_t>((end - start).count()));
+    stats_detail::bump(counters.tasks_run, 1);
+    counters.last_end = end;
+#else
+    invoke(task);
+#endif
+    if (_trace != nullptr) {
+        trace_span(index, traced_at, priority, false);
+    }
+    finish_task();
+}
+
+inline void ThreadPool::trace_span(size_t index, std::chrono::steady_clock::time_point begin, TaskPriority priority,
+                                   bool helping) {
+    const auto end = std::chrono::steady_clock::now();
+    _trace[index].record(TraceRing::Span{ std::chrono::nanoseconds(begin - _trace_epoch).count(),
+                                          std::chrono::nanoseconds(end - _trace_epoch).count(),
+                                          static_cast<uint8_t>(priority), helping });
+}
+
+// runs a task, handing anything it throws to on_exception
+inline void ThreadPool::invoke(InlineTask& task) {
+    try {
+        task();
+    } catch (...) {
+        if (!_on_exception) {
+            std::terminate();
+        }
+        _on_exception(std::current_exception());
+    }
+}
+
+// the last task to finish wakes up wait_idle()
+inline void ThreadPool::finish_task() {
+    if (_unfinished.fetch_sub(1) == 1 && _idle_waiters.load() > 0) {
+        { std::unique_lock<std::mutex> lock(_idle_mutex); }
+        _idle_condition.notify_all();
+    }
+}
+
+// _idle_waiters is raised before _unfinished is checked, so the last finisher either
+// sees the waiter or the waiter sees zero
+inline void ThreadPool::wait_idle() {
+    if (_current_pool == this) {
+        throw std::logic_error("wait_idle called from a ThreadPool worker");
+    }
+    std::unique_lock<std::mutex> lock(_idle_mutex);
+    _idle_waiters.fetch_add(1);
+    _idle_condition.wait(
+        lock,
+        [this]() -> bool {
+            return _unfinished.load() == 0;
+        });
+    _idle_waiters.fetch_sub(1);
+}
+
+// remembers when a task entered a queue, called right before it is published
+inline void ThreadPool::stamp([[maybe_unused]] InlineTask& task) {
+#if THREAD_POOL_INSTRUMENTATION
+    task.set_queued_at(std::chrono::steady_clock::now());
+#endif
+}
+
+inline void ThreadPool::add_pending(size_t count) {
+    _unfinished.fetch_add(count);
+    note_queue_depth(_pending.fetch_add(count) + count);
+}
+
+// BOUNDED_QUEUE: add_pending(1), unless that would take _pending past queue_capacity
+inline auto ThreadPool::reserve_slot() -> bool {
+    size_t pending = _pending.load();
+    do {
+        if (pending >= _ring->capacity()) {
+            return false;
+        }
+    } while (!_pending.compare_exchange_weak(pending, pending + 1));
+    _unfinished.fetch_add(1);
+    note_queue_depth(pending + 1);
+    return true;
+}
+
+inline void ThreadPool::note_queue_depth([[maybe_unused]] size_t pending) {
+#if THREAD_POOL_INSTRUMENTATION
+    size_t high_water = _queue_high_water.load(std::memory_order_relaxed);
+    while (pending > high_water
+           && !_queue_high_water.compare_exchange_weak(high_water, pending, std::memory_order_relaxed)) {
+    }
+#endif
+}
+
+inline void ThreadPool::note_steal([[maybe_unused]] size_t index) {
+#if THREAD_POOL_INSTRUMENTATION
+    stats_detail::bump(_counters[index].steals, 1);
+#endif
+}
+
+inline void ThreadPool::note_inline_run([[maybe_unused]] size_t index) {
+#if THREAD_POOL_INSTRUMENTATION
+    stats_detail::bump(_counters[index].inline_runs, 1);
+#endif
+}
+
+inline auto ThreadPool::stats() const -> ThreadPoolStats {
+    ThreadPoolStats stats;
+#if THREAD_POOL_INSTRUMENTATION
+    stats.enabled = true;
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        stats.workers.push_back(_counters[i].snapshot());
+        _counters[i].queue_wait.add_to(stats.queue_wait);
+        for (size_t priority = 0; priority < PRIORITY_CLASSES; ++priority) {
+            _counters[i].queue_wait_by_priority[priority].add_to(stats.queue_wait_by_priority[priority]);
+        }
+        _counters[i].execution.add_to(stats.execution);
+    }
+    stats.queue_depth_high_water = _queue_high_water.load(std::memory_order_relaxed);
+#endif
+    return stats;
+}
+
+inline void ThreadPool::write_trace(std::ostream& out) const {
+    out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    bool first = true;
+    if (_trace != nullptr) {
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << i
+                << R"(,"args":{"name":"worker )" << i << R"("}})";
+            first = false;
+            _trace[i].write_json(out, i, first);
+        }
+    }
+    out << "\n]}\n";
+}
+
+inline auto ThreadPool::timers() -> TimerQueue& {
+    std::call_once(
+        _timers_once,
+        [this]() {
+            _timers = std::make_unique<TimerQueue>([this](InlineTask task) { dispatch_timer(std::move(task)); });
+            _timers_started.store(true, std::memory_order_release);
+        });
+    return *_timers;
+}
+
+// the timer thread must not wait for space in a full ring, every other due timer would wait
+// behind it. a task that doesn't fit goes to the priority lanes instead, which never wait,
+// as a task that is due now
+inline void ThreadPool::dispatch_timer(InlineTask task) {
+    if (_mode != SchedulingMode::BOUNDED_QUEUE) {
+        push_task(std::move(task));
+        return;
+    }
+    if (try_push_bounded(task)) {
+        wake_workers(1);
+        return;
+    }
+    TaskOptions options;
+    options.deadline = std::chrono::steady_clock::now();
+    push_prioritized(options, std::move(task));
+}
+
+template <typename F>
+auto ThreadPool::schedule_after(std::chrono::steady_clock::duration delay, F&& f) -> TimerId {
+    return timers().add(std::chrono::steady_clock::now() + delay, std::chrono::steady_clock::duration::zero(),
+                        make_inline(std::forward<F>(f)));
+}
+
+template <typename F>
+auto ThreadPool::schedule_every(std::chrono::steady_clock::duration period, F&& f) -> TimerId {
+    if (period <= std::chrono::steady_clock::duration::zero()) {
+        throw std::invalid_argument("schedule_every needs a positive period");
+    }
+    return timers().add(std::chrono::steady_clock::now() + period, period, make_inline(std::forward<F>(f)));
+}
+
+inline auto ThreadPool::cancel_timer(TimerId id) -> bool {
+    if (!_timers_started.load(std::memory_order_acquire)) {
+        return false;
+    }
+    return _timers->cancel(id);
+}
+
+// every grow_threshold, compare the tasks that were pending at the last sample with the
+// tasks dequeued since. if fewer were dequeued, at least one of them has been waiting
+// for a whole period, which means the workers aren't keeping up
+inline void ThreadPool::supervisor_loop() {
+    size_t pending_before = _pending.load();
+    size_t dequeued_before = _dequeued.load();
+
+    std::unique_lock<std::mutex> lock(_supervisor_mutex);
+    while (true) {
+        _supervisor_condition.wait_for(
+            lock,
+            _grow_threshold,
+            [this]() -> bool {
+                return _stop.load();
+            });
+        if (_stop) {
+            return;
+        }
+
+        const size_t pending_now = _pending.load();
+        const size_t dequeued_now = _dequeued.load();
+        const bool delayed = pending_before > 0 && dequeued_now - dequeued_before < pending_before;
+        if (delayed || (pending_now > 0 && size() == 0)) {
+            grow();
+        }
+        pending_before = pending_now;
+        dequeued_before = dequeued_now;
+    }
+}
+
+inline auto ThreadPool::grow() -> bool {
+    size_t threads = 0;
+    {
+        std::unique_lock<std::mutex> lock(_workers_mutex);
+        size_t index = 0;
+        while (index < _workers.size() && _workers[index].active) {
+            ++index;
+        }
+        if (index == _workers.size() || _stop) {
+            return false;
+        }
+        start_worker(index);
+        threads = size();
+    }
+    _grow_count.fetch_add(1, std::memory_order_relaxed);
+    report_resize(ResizeKind::GROW, threads);
+    return true;
+}
+
+// called by an idle worker holding _queue_mutex, true if it should exit
+inline auto ThreadPool::try_retire(size_t index) -> bool {
+    std::unique_lock<std::mutex> lock(_workers_mutex);
+    if (_stop || size() <= _min_threads) {
+        return false;
+    }
+    _workers[index].active = false;
+    _active_workers.fetch_sub(1, std::memory_order_relaxed);
+    _retire_count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+inline void ThreadPool::report_resize(ResizeKind kind, size_t threads) {
+    if (_on_resize) {
+        _on_resize(ResizeEvent{ kind, threads });
+    }
+}
+
+inline void ThreadPool::push_task(InlineTask task, Placement placement) {
+    if (_mode == SchedulingMode::SHARED_QUEUE && !_per_node_queues) {
+        {
+            std::unique_lock<std::mutex> lock(_queue_mutex);
+
+            // don't allow enqueueing after stopping the pool, except from a worker: the pool
+            // is still draining, and the worker runs the task itself before it exits
+            if (_stop && _current_pool != this) {
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            }
+
+            stamp(task);
+            _tasks.emplace_back(std::move(task));
+            add_pending(1);
+        }
+        wake_workers(1);
+        return;
+    }
+
+    if (_mode == SchedulingMode::BOUNDED_QUEUE) {
+        if (_current_pool != this && _stop.load()) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+        if (push_local(task) || push_bounded(task)) {
+            wake_workers(1);
+        }
+        return;
+    }
+
+    const bool from_worker = _current_pool == this;
+    // in WORK_STEALING mode outside tasks wait in _injected, the owner of a deque would
+    // run them newest first
+    const bool injected = _mode == SchedulingMode::WORK_STEALING && !from_worker
+                          && placement.kind == Placement::Kind::ANY;
+
+    {
+        WorkerQueue& queue = injected ? _injected : _worker_queues[pick_queue(placement)];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+
+        // workers may still add to their own deque while the pool drains
+        if (!from_worker && _stop.load()) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+
+        stamp(task);
+        queue.tasks.emplace_back(std::move(task));
+        add_pending(1);
+    }
+
+    wake_workers(1);
+}
+
+// BOUNDED_QUEUE: a worker queues its tasks on its own deque while the pool holds fewer than
+// queue_capacity tasks, so waiting for them can help with them (see take_task). false for
+// anyone else, or when the pool is full and beyond_capacity isn't set
+inline auto ThreadPool::push_local(InlineTask& task, bool beyond_capacity) -> bool {
+    if (_current_pool != this) {
+        return false;
+    }
+    if (beyond_capacity) {
+        add_pending(1);
+    } else if (!reserve_slot()) {
+        return false;
+    }
+    WorkerQueue& queue = _worker_queues[_home_queue[_current_index]];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    stamp(task);
+    queue.tasks.emplace_back(std::move(task));
+    return true;
+}
+
+// plain NORMAL tasks take the regular queues, everything else goes to the lanes
+inline void ThreadPool::push_prioritized(const TaskOptions& options, InlineTask task) {
+    if (options.priority == TaskPriority::NORMAL && !options.deadline) {
+        push_task(std::move(task));
+        return;
+    }
+
+    const bool single_queue = _mode == SchedulingMode::SHARED_QUEUE && !_per_node_queues;
+    {
+        std::unique_lock<std::mutex> lock(single_queue ? _queue_mutex : _lanes_mutex);
+
+        // same rule as push_task: workers may still submit while the pool drains
+        if (_stop.load() && _current_pool != this) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+
+        stamp(task);
+        _lanes.push(options, std::move(task));
+        add_pending(1);
+    }
+    wake_workers(1);
+}
+
+inline void ThreadPool::push_tasks(std::vector<InlineTask>& tasks) {
+    const size_t count = tasks.size();
+    if (count == 0) {
+        return;
+    }
+
+    if (_mode == SchedulingMode::SHARED_QUEUE && !_per_node_queues) {
+        {
+            std::unique_lock<std::mutex> lock(_queue_mutex);
+
+            if (_stop && _current_pool != this) {
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            }
+
+            for (InlineTask& task : tasks) {
+                stamp(task);
+                _tasks.emplace_back(std::move(task));
+            }
+            add_pending(count);
+        }
+        wake_workers(count);
+        return;
+    }
+
+    if (_mode == SchedulingMode::BOUNDED_QUEUE) {
+        if (_current_pool != this && _stop.load()) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+        size_t queued = 0;
+        for (InlineTask& task : tasks) {
+            if (push_local(task) || push_bounded(task)) {
+                ++queued;
+            }
+        }
+        wake_workers(queued);
+        return;
+    }
+
+    if (_current_pool == this) {
+        // a worker keeps the whole batch, idle workers will steal from it
+        WorkerQueue& queue = _worker_queues[_home_queue[_current_index]];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        for (InlineTask& task : tasks) {
+            stamp(task);
+            queue.tasks.emplace_back(std::move(task));
+        }
+        add_pending(count);
+    } else if (_mode == SchedulingMode::WORK_STEALING) {
+        std::unique_lock<std::mutex> lock(_injected.mutex);
+        if (_stop.load()) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+        for (InlineTask& task : tasks) {
+            stamp(task);
+            _injected.tasks.emplace_back(std::move(task));
+        }
+        add_pending(count);
+    } else {
+        if (_stop.load()) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+
+        // hand each deque one contiguous slice so every deque is locked at most once
+        const size_t queues = _worker_queues.size();
+        const size_t first_queue = _next_queue.fetch_add(1, std::memory_order_relaxed);
+        size_t begin = 0;
+        for (size_t i = 0; i < queues && begin < count; ++i) {
+            const size_t slice = (count / queues) + (i < count % queues ? 1 : 0);
+            WorkerQueue& queue = _worker_queues[(first_queue + i) % queues];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            for (size_t j = begin; j < begin + slice; ++j) {
+                stamp(tasks[j]);
+                queue.tasks.emplace_back(std::move(tasks[j]));
+            }
+            add_pending(slice);
+            begin += slice;
+        }
+    }
+
+    wake_workers(count);
+}
+
+// wake at most count parked workers
+inline void ThreadPool::wake_workers(size_t count) {
+    // spinning workers pick the new tasks up on their own
+    const size_t spinning = _spinning.load();
+    if (spinning >= count) {
+        return;
+    }
+    count -= spinning;
+
+    if (_mode == SchedulingMode::SHARED_QUEUE && !_per_node_queues) {
+        if (count >= size()) {
+            _condition.notify_all();
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                _condition.notify_one();
+            }
+        }
+        return;
+    }
+
+    const size_t sleeping = _sleeping.load();
+    if (sleeping == 0) {
+        return;
+    }
+
+    // taking the lock orders us against a worker between its predicate check and wait()
+    { std::unique_lock<std::mutex> lock(_queue_mutex); }
+    if (count >= sleeping) {
+        _condition.notify_all();
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            _condition.notify_one();
+        }
+    }
+}
+
+// claims a slot in _pending first so consumers and waiting producers never see too few tasks
+inline auto ThreadPool::try_push_bounded(InlineTask& task) -> bool {
+    if (!reserve_slot()) {
+        return false;
+    }
+    stamp(task);
+    if (_ring->try_push(task)) {
+        return true;
+    }
+    release_slot();
+    finish_task();
+    return false;
+}
+
+// returns false if the task was run on the calling worker instead of being queued
+inline auto ThreadPool::push_bounded(InlineTask& task) -> bool {
+    while (!try_push_bounded(task)) {
+        if (_current_pool == this) {
+            // a worker waiting for space could wait forever once every worker does it. running
+            // the task here nests it on the stack like helping does, so past MAX_HELP_DEPTH it
+            // goes over capacity instead
+            if (_help_depth >= MAX_HELP_DEPTH) {
+                return push_local(task, true);
+            }
+            note_inline_run(_current_index);
+            const NestedRun nested;
+            invoke(task);
+            return false;
+        }
+
+        // a batch may have filled the ring before anyone was woken up
+        wake_workers(size());
+
+        std::unique_lock<std::mutex> lock(_space_mutex);
+        _waiting_producers.fetch_add(1);
+        _space_condition.wait(
+            lock,
+            [this]() -> bool {
+                return _stop || _pending.load() < _ring->capacity();
+            });
+        _waiting_producers.fetch_sub(1);
 
-        // don't allow enqueueing after stopping the pool
         if (_stop) {
             throw std::runtime_error("enqueue on stopped ThreadPool");
         }
+    }
+    return true;
+}
+
+// gives back a _pending slot and lets one waiting producer retry
+inline void ThreadPool::release_slot() {
+    _pending.fetch_sub(1);
+    if (_waiting_producers.load() > 0) {
+        { std::unique_lock<std::mutex> lock(_space_mutex); }
+        _space_condition.notify_one();
+    }
+}
+
+// the queue a task goes to when the pool has more than one
+inline auto ThreadPool::pick_queue(Placement placement) -> size_t {
+    switch (placement.kind) {
+        case Placement::Kind::WORKER: return _home_queue[placement.index];
+        case Placement::Kind::NODE:
+            if (_per_node_queues) {
+                return placement.index;
+            }
+            if (const std::vector<size_t>& workers = _node_workers[placement.index]; !workers.empty()) {
+                return workers[_next_queue.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+            }
+            break;
+        case Placement::Kind::ANY:
+            // tasks submitted from one of our workers stay on that worker's queue
+            if (_current_pool == this) {
+                return _home_queue[_current_index];
+            }
+            break;
+    }
+    return _next_queue.fetch_add(1, std::memory_order_relaxed) % _worker_queues.size();
+}
+
+// a worker deque is LIFO for its owner, a node queue is shared by the node's workers and stays
+// FIFO unless a helper asks for the newest task
+inline auto ThreadPool::pop_local_task(size_t index, InlineTask& task, bool newest) -> bool {
+    WorkerQueue& queue = _worker_queues[_home_queue[index]];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    if (_per_node_queues && !newest) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+    } else {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+    }
+    note_taken();
+    return true;
+}
+
+inline auto ThreadPool::steal_task(size_t index, InlineTask& task) -> bool {
+    for (size_t victim_index : _steal_order[index]) {
+        WorkerQueue& victim = _worker_queues[victim_index];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) {
+            continue;
+        }
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        note_taken();
+        note_steal(index);
+        return true;
+    }
+    return false;
+}
+
+// the oldest task submitted from outside a WORK_STEALING pool
+inline auto ThreadPool::pop_injected(InlineTask& task) -> bool {
+    if (_mode != SchedulingMode::WORK_STEALING) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(_injected.mutex);
+    if (_injected.tasks.empty()) {
+        return false;
+    }
+    task = std::move(_injected.tasks.front());
+    _injected.tasks.pop_front();
+    note_taken();
+    return true;
+}
+
+// a task left a queue. in BOUNDED_QUEUE mode that makes room for a waiting producer
+inline void ThreadPool::note_taken() {
+    if (_mode == SchedulingMode::BOUNDED_QUEUE) {
+        release_slot();
+    } else {
+        _pending.fetch_sub(1);
+    }
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::make_task(F&& f, Args&&... args) -> std::packaged_task<std::invoke_result_t<F, Args...>()> {
+    using return_type = std::invoke_result_t<F, Args...>;
+
+    // the callable and the arguments are moved into the packaged_task's shared state,
+    // which is the only allocation: the packaged_task itself fits inside InlineTask
+    return std::packaged_task<return_type()>(
+        [f = std::forward<F>(f),
+         args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable -> return_type {
+            return std::apply(std::move(f), std::move(args));
+        });
+}
+
+// the callable for post: f itself when there are no arguments, so it stays as small as possible
+template <typename F, typename... Args>
+auto ThreadPool::make_job(F&& f, Args&&... args) {
+    if constexpr (sizeof...(Args) == 0) {
+        return std::decay_t<F>(std::forward<F>(f));
+    } else {
+        return [f = std::forward<F>(f),
+                args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+            std::apply(std::move(f), std::move(args));
+        };
+    }
+}
+
+// InlineTask for f, a closure too big for its buffer goes to the worker arenas if we have them
+template <typename F>
+auto ThreadPool::make_inline(F&& f) -> InlineTask {
+    return InlineTask(std::allocator_arg, _task_memory, std::forward<F>(f));
+}
+
+// the task behind enqueue and its future. with a memory_resource a promise replaces the
+// packaged_task, since only promise takes an allocator for its shared state
+template <typename F, typename... Args>
+auto ThreadPool::package(std::stop_token token, F&& f, Args&&... args)
+    -> std::pair<InlineTask, std::future<std::invoke_result_t<F, Args...>>> {
+    using return_type = std::invoke_result_t<F, Args...>;
+
+    reject_if_overloaded();
+
+    if (_task_memory == nullptr) {
+        auto task = make_task(std::forward<F>(f), std::forward<Args>(args)...);
+        auto res = task.get_future();
+        return { guard(std::move(token), true, std::move(task)), std::move(res) };
+    }
+
+    std::promise<return_type> promise(std::allocator_arg, std::pmr::polymorphic_allocator<return_type>(_task_memory));
+    auto res = promise.get_future();
+    InlineTask task = guard(
+        std::move(token), true,
+        [promise = std::move(promise), f = std::forward<F>(f),
+         args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+            try {
+                if constexpr (std::is_void_v<return_type>) {
+                    std::apply(std::move(f), std::move(args));
+                    promise.set_value();
+                } else {
+                    promise.set_value(std::apply(std::move(f), std::move(args)));
+                }
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        });
+    return { std::move(task), std::move(res) };
+}
+
+// the job itself, or a wrapper that drops it before it starts once token is stopped or, if it
+// is sheddable, once it waited past queue_budget. a dropped job is destroyed unrun, which
+// breaks the promise of an enqueued task
+template <typename Job>
+auto ThreadPool::guard(std::stop_token token, bool sheddable, Job job) -> InlineTask {
+    const bool shed = sheddable && _overload_policy != OverloadPolicy::NONE;
+    if (!token.stop_possible() && !shed) {
+        return make_inline(std::move(job));
+    }
+    return make_inline(
+        [this, shed, token = std::move(token),
+         queued_at = shed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{},
+         job = std::move(job)]() mutable {
+            if (!should_drop(token, shed, queued_at)) {
+                job();
+            }
+        });
+}
+
+inline auto ThreadPool::should_drop(const std::stop_token& token, bool shed,
+                                    std::chrono::steady_clock::time_point queued_at) -> bool {
+    if (token.stop_requested()) {
+        _cancelled_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    if (!shed) {
+        return false;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - queued_at <= _queue_budget) {
+        return false;
+    }
+    _shed_count.fetch_add(1, std::memory_order_relaxed);
+    _overloaded_until.store((now + _queue_budget).time_since_epoch().count(), std::memory_order_relaxed);
+    return true;
+}
+
+// with OverloadPolicy::REJECT, true for one queue_budget after a task was shed
+inline auto ThreadPool::overloaded() const -> bool {
+    return _overload_policy == OverloadPolicy::REJECT
+           && std::chrono::steady_clock::now().time_since_epoch().count()
+                  < _overloaded_until.load(std::memory_order_relaxed);
+}
+
+inline void ThreadPool::reject_if_overloaded() {
+    if (overloaded()) {
+        _rejected_count.fetch_add(1, std::memory_order_relaxed);
+        throw std::runtime_error("enqueue on overloaded ThreadPool");
+    }
+}
+
+template <typename F, typename... Args>
+void ThreadPool::post(F&& f, Args&&... args) {
+    push_task(make_inline(make_job(std::forward<F>(f), std::forward<Args>(args)...)));
+}
+
+template <typename F, typename... Args>
+void ThreadPool::post_with(const TaskOptions& options, F&& f, Args&&... args) {
+    push_prioritized(options, guard(options.stop_token, false, make_job(std::forward<F>(f), std::forward<Args>(args)...)));
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::enqueue_with(const TaskOptions& options, F&& f, Args&&... args)
+    -> std::future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] = package(options.stop_token, std::forward<F>(f), std::forward<Args>(args)...);
+    push_prioritized(options, std::move(task));
+    return std::move(res);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::try_post(F&& f, Args&&... args) -> bool {
+    if (_mode != SchedulingMode::BOUNDED_QUEUE) {
+        post(std::forward<F>(f), std::forward<Args>(args)...);
+        return true;
+    }
+
+    if (_current_pool != this && _stop.load()) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
+
+    InlineTask task = make_inline(make_job(std::forward<F>(f), std::forward<Args>(args)...));
+    if (!push_local(task) && !try_push_bounded(task)) {
+        return false;
+    }
+    wake_workers(1);
+    return true;
+}
 
-        _tasks.emplace([task]() { (*task)(); });
+// add new work item to the pool
+template <typename F, typename... Args>
+auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] = package(std::stop_token(), std::forward<F>(f), std::forward<Args>(args)...);
+    push_task(std::move(task));
+    return std::move(res);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::enqueue(std::stop_token token, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] = package(std::move(token), std::forward<F>(f), std::forward<Args>(args)...);
+    push_task(std::move(task));
+    return std::move(res);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::enqueue_on_node(size_t node, F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+    const auto found = std::find(_node_ids.begin(), _node_ids.end(), static_cast<int>(node));
+    if (found == _node_ids.end()) {
+        throw std::out_of_range("enqueue_on_node: no such NUMA node");
+    }
+    auto [task, res] = package(std::stop_token(), std::forward<F>(f), std::forward<Args>(args)...);
+    push_task(std::move(task), Placement{ Placement::Kind::NODE, static_cast<size_t>(found - _node_ids.begin()) });
+    return std::move(res);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::enqueue_on_worker(size_t worker, F&& f, Args&&... args)
+    -> std::future<std::invoke_result_t<F, Args...>> {
+    if (worker >= _workers.size()) {
+        throw std::out_of_range("enqueue_on_worker: no such worker");
     }
-    _condition.notify_one();
+    auto [task, res] = package(std::stop_token(), std::forward<F>(f), std::forward<Args>(args)...);
+    push_task(std::move(task), Placement{ Placement::Kind::WORKER, worker });
+    return std::move(res);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::try_enqueue(F&& f, Args&&... args) -> std::optional<std::future<std::invoke_result_t<F, Args...>>> {
+    if (overloaded()) {
+        _rejected_count.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    if (_mode != SchedulingMode::BOUNDED_QUEUE) {
+        return enqueue(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    if (_current_pool != this && _stop.load()) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
+
+    auto [task, res] = package(std::stop_token(), std::forward<F>(f), std::forward<Args>(args)...);
+    if (!push_local(task) && !try_push_bounded(task)) {
+        return std::nullopt;
+    }
+    wake_workers(1);
+    return std::move(res);
+}
+
+template <typename InputIt>
+auto ThreadPool::enqueue_bulk(InputIt first, InputIt last)
+    -> std::vector<std::future<std::invoke_result_t<typename std::iterator_traits<InputIt>::reference>>> {
+    using return_type = std::invoke_result_t<typename std::iterator_traits<InputIt>::reference>;
+
+    std::vector<InlineTask> tasks;
+    std::vector<std::future<return_type>> res;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                    typename std::iterator_traits<InputIt>::iterator_category>) {
+        const auto count = static_cast<size_t>(std::distance(first, last));
+        tasks.reserve(count);
+        res.reserve(count);
+    }
+
+    for (; first != last; ++first) {
+        auto [task, future] = package(std::stop_token(), *first);
+        res.emplace_back(std::move(future));
+        tasks.emplace_back(std::move(task));
+    }
+
+    push_tasks(tasks);
+    return res;
+}
+
+template <typename F>
+auto ThreadPool::enqueue_bulk(size_t count, F f) -> std::vector<std::future<std::invoke_result_t<F&, size_t>>> {
+    using return_type = std::invoke_result_t<F&, size_t>;
+
+    std::vector<InlineTask> tasks;
+    std::vector<std::future<return_type>> res;
+    tasks.reserve(count);
+    res.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto [task, future] = package(
+            std::stop_token(),
+            [f, i]() mutable -> return_type {
+                return std::invoke(f, i);
+            });
+        res.emplace_back(std::move(future));
+        tasks.emplace_back(std::move(task));
+    }
+
+    push_tasks(tasks);
     return res;
 }
 
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool() {
+    // no new timer runs once we start stopping. the queue itself outlives the workers,
+    // which may still finish periodic runs that try to rearm
+    if (_timers) {
+        _timers->stop();
+    }
     {
         std::unique_lock<std::mutex> lock(_queue_mutex);
         _stop = true;
     }
     _condition.notify_all();
-    for (std::thread& worker : _workers) {
-        worker.join();
+    {
+        std::unique_lock<std::mutex> lock(_space_mutex);
+    }
+    _space_condition.notify_all();
+    {
+        std::unique_lock<std::mutex> lock(_supervisor_mutex);
+    }
+    _supervisor_condition.notify_all();
+    if (_supervisor.joinable()) {
+        _supervisor.join();
+    }
+
+    // slots can't change any more: the supervisor is gone and workers don't retire once stopped
+    for (WorkerSlot& worker : _workers) {
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+    }
+
+    // whatever is still queued, pending timers included, is freed after this and
+    // takes the arenas' late path, like any future the caller still holds
+    if (_task_memory != nullptr) {
+        _task_memory->close();
     }
 }
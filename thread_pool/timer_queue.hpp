@@ -0,0 +1,204 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "inline_task.hpp"
+
+// the deadlines behind ThreadPool::schedule_after/schedule_every. one thread sleeps until the
+// earliest deadline in a min-heap and hands whatever is due to `dispatch`, so any number of
+// timers costs one thread and one wait. cancelled timers leave the index right away and the
+// heap when their deadline comes up, or when stale entries start to outnumber live ones
+class TimerQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+    explicit TimerQueue(std::function<void(InlineTask)> dispatch)
+        : _dispatch(std::move(dispatch)),
+          _thread([this]() { this->run(); }) {}
+
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+    TimerQueue(TimerQueue&&) = delete;
+    TimerQueue& operator=(TimerQueue&&) = delete;
+
+    ~TimerQueue() { stop(); }
+
+    // period 0 fires once
+    auto add(Clock::time_point deadline, Clock::duration period, InlineTask task) -> TimerId {
+        bool earliest = false;
+        TimerId id = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            id = _next_id++;
+            _timers.emplace(id, Timer{ std::make_shared<InlineTask>(std::move(task)), period });
+            earliest = _heap.empty() || deadline < _heap.top().deadline;
+            _heap.push(Entry{ deadline, id });
+        }
+        // the timer thread only needs to wake up if its current sleep is now too long
+        if (earliest) {
+            _condition.notify_one();
+        }
+        return id;
+    }
+
+    // false if the timer already fired once and for all, or was cancelled before
+    auto cancel(TimerId id) -> bool {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_timers.erase(id) == 0) {
+            return false;
+        }
+        if (_heap.size() > 2 * _timers.size() + COMPACT_SLACK) {
+            compact();
+        }
+        return true;
+    }
+
+    // timers that haven't fired yet, periodic ones count until they are cancelled
+    [[nodiscard]] auto size() -> size_t {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _timers.size();
+    }
+
+    // drops every pending timer. periodic tasks that are already queued run one last time
+    void stop() {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+private:
+    static constexpr size_t COMPACT_SLACK = 1024;
+
+    struct Entry {
+        Clock::time_point deadline;
+        TimerId id;
+
+        auto operator>(const Entry& other) const -> bool { return deadline > other.deadline; }
+    };
+
+    struct Timer {
+        // shared with the queued run of a periodic timer, which may outlive a cancel
+        std::shared_ptr<InlineTask> task;
+        Clock::duration period;
+    };
+
+    void run() {
+        std::vector<InlineTask> due;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stop) {
+            if (_heap.empty()) {
+                _condition.wait(lock);
+                continue;
+            }
+            const Clock::time_point now = Clock::now();
+            // a copy: wait_until holds on to it while add() may grow the heap
+            const Clock::time_point next = _heap.top().deadline;
+            if (next > now) {
+                _condition.wait_until(lock, next);
+                continue;
+            }
+
+            while (!_heap.empty() && _heap.top().deadline <= now) {
+                const Entry entry = _heap.top();
+                _heap.pop();
+                auto timer = _timers.find(entry.id);
+                if (timer == _timers.end()) {
+                    continue;
+                }
+                if (timer->second.period == Clock::duration::zero()) {
+                    due.emplace_back(std::move(*timer->second.task));
+                    _timers.erase(timer);
+                } else {
+                    due.emplace_back(periodic_run(entry, timer->second.task));
+                }
+            }
+
+            lock.unlock();
+            for (InlineTask& task : due) {
+                try {
+                    _dispatch(std::move(task));
+                } catch (...) {
+                    // the pool is shutting down, the task is dropped like any other pending timer
+                }
+            }
+            due.clear();
+            lock.lock();
+        }
+    }
+
+    // one run of a periodic timer. the next deadline is only armed once this run is over,
+    // so runs never overlap and periods missed in the meantime are skipped
+    auto periodic_run(Entry entry, std::shared_ptr<InlineTask> task) -> InlineTask {
+        return [this, entry, task = std::move(task)]() {
+            try {
+                (*task)();
+            } catch (...) {
+                rearm(entry);
+                throw;
+            }
+            rearm(entry);
+        };
+    }
+
+    void rearm(Entry entry) {
+        bool earliest = false;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto timer = _timers.find(entry.id);
+            if (_stop || timer == _timers.end()) {
+                return;
+            }
+            const Clock::duration period = timer->second.period;
+            const Clock::time_point now = Clock::now();
+            entry.deadline += period;
+            if (entry.deadline <= now) {
+                entry.deadline += ((now - entry.deadline) / period + 1) * period;
+            }
+            earliest = _heap.empty() || entry.deadline < _heap.top().deadline;
+            _heap.push(entry);
+        }
+        if (earliest) {
+            _condition.notify_one();
+        }
+    }
+
+    // needs _mutex. rebuilds the heap without the entries of cancelled timers
+    void compact() {
+        std::vector<Entry> live;
+        live.reserve(_timers.size());
+        while (!_heap.empty()) {
+            if (_timers.contains(_heap.top().id)) {
+                live.push_back(_heap.top());
+            }
+            _heap.pop();
+        }
+        _heap = decltype(_heap)(std::greater<>(), std::move(live));
+    }
+
+    std::function<void(InlineTask)> _dispatch;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> _heap;
+    std::unordered_map<TimerId, Timer> _timers;
+    TimerId _next_id = 1;
+    bool _stop = false;
+    // last, so it starts after everything it uses is constructed
+    std::thread _thread;
+};
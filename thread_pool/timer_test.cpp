@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+    constexpr std::chrono::seconds PATIENCE{ 10 };
+
+    // keeps a worker busy until opened
+    class Gate {
+    public:
+        void enter() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _entered = true;
+            _condition.notify_all();
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _open;
+                });
+        }
+
+        void wait_entered() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(
+                lock,
+                [this]() -> bool {
+                    return _entered;
+                });
+        }
+
+        void open() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _open = true;
+            _condition.notify_all();
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _entered = false;
+        bool _open = false;
+    };
+
+} // namespace
+
+int main() {
+    using namespace std::chrono_literals;
+
+    int failures = 0;
+    for (const SchedulingMode mode : { SchedulingMode::SHARED_QUEUE, SchedulingMode::WORK_STEALING,
+                                       SchedulingMode::BOUNDED_QUEUE }) {
+        ThreadPoolConfig config;
+        config.threads = 2;
+        config.mode = mode;
+        ThreadPool pool(config);
+
+        // nothing to cancel before the first timer
+        if (pool.cancel_timer(1)) {
+            std::printf("mode %d: cancelled a timer that was never scheduled\n", static_cast<int>(mode));
+            ++failures;
+        }
+
+        std::promise<void> fired;
+        pool.schedule_after(5ms, [&fired]() { fired.set_value(); });
+        if (fired.get_future().wait_for(PATIENCE) != std::future_status::ready) {
+            std::printf("mode %d: schedule_after never fired\n", static_cast<int>(mode));
+            ++failures;
+        }
+
+        std::atomic<bool> cancelled_ran{ false };
+        const ThreadPool::TimerId late = pool.schedule_after(1h, [&cancelled_ran]() { cancelled_ran = true; });
+        if (!pool.cancel_timer(late) || pool.cancel_timer(late)) {
+            std::printf("mode %d: cancel_timer should succeed once\n", static_cast<int>(mode));
+            ++failures;
+        }
+
+        // a periodic timer keeps firing until cancelled, then fires at most once more
+        // for a run that was already queued
+        std::atomic<int> ticks{ 0 };
+        const ThreadPool::TimerId periodic = pool.schedule_every(1ms, [&ticks]() { ticks.fetch_add(1); });
+        const auto give_up = std::chrono::steady_clock::now() + PATIENCE;
+        while (ticks < 3 && std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::sleep_for(1ms);
+        }
+        const bool stopped = pool.cancel_timer(periodic);
+        const int ticks_at_cancel = ticks;
+        std::this_thread::sleep_for(20ms);
+        pool.wait_idle();
+        if (ticks_at_cancel < 3 || !stopped || ticks > ticks_at_cancel + 1 || cancelled_ran) {
+            std::printf("mode %d: %d ticks at cancel, %d after\n", static_cast<int>(mode), ticks_at_cancel,
+                        ticks.load());
+            ++failures;
+        }
+    }
+
+    // a timer due while the BOUNDED_QUEUE ring is full doesn't wait for space, it goes to the
+    // priority lanes with the timers due after it, and they run ahead of what fills the ring
+    {
+        ThreadPoolConfig config;
+        config.threads = 1;
+        config.mode = SchedulingMode::BOUNDED_QUEUE;
+        config.queue_capacity = 2;
+        ThreadPool pool(config);
+        Gate gate;
+        pool.post([&gate]() { gate.enter(); });
+        gate.wait_entered();
+        std::atomic<int> fillers_run{ 0 };
+        while (pool.try_post([&fillers_run]() { fillers_run.fetch_add(1); })) {
+        }
+
+        std::atomic<int> fired{ 0 };
+        std::atomic<int> fired_first{ 0 };
+        auto timer = [&fired, &fired_first, &fillers_run]() {
+            if (fillers_run == 0) {
+                fired_first.fetch_add(1);
+            }
+            fired.fetch_add(1);
+        };
+        pool.schedule_after(1ms, timer);
+        pool.schedule_after(2ms, timer);
+        std::this_thread::sleep_for(20ms);
+        // cancel_timer shares the timer thread's lock
+        const ThreadPool::TimerId spare = pool.schedule_after(1h, []() {});
+        const bool cancelled = pool.cancel_timer(spare);
+        gate.open();
+        const auto give_up = std::chrono::steady_clock::now() + PATIENCE;
+        while (fired < 2 && std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::sleep_for(1ms);
+        }
+        if (fired != 2 || fired_first != 2 || !cancelled) {
+            std::printf("full ring: %d of 2 timers fired, %d ahead of the ring, cancel_timer %s\n", fired.load(),
+                        fired_first.load(), cancelled ? "succeeded" : "failed");
+            ++failures;
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("timers: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// the latest task spans of one worker, for ThreadPool::write_trace. only the worker writes,
+// a span is two stores and a counter bump, and once the ring is full the oldest spans are
+// overwritten. readers must not race the writer: read while the pool is idle
+class TraceRing {
+public:
+    struct Span {
+        // nanoseconds since the pool started tracing
+        int64_t begin_ns;
+        int64_t end_ns;
+        // TaskPriority of the task
+        uint8_t priority;
+        // run by a thread waiting for a future (see ThreadPool::help_until), nested in its task
+        bool helping;
+    };
+
+    TraceRing() = default;
+
+    TraceRing(const TraceRing&) = delete;
+    TraceRing& operator=(const TraceRing&) = delete;
+    TraceRing(TraceRing&&) = delete;
+    TraceRing& operator=(TraceRing&&) = delete;
+
+    ~TraceRing() = default;
+
+    // capacity is rounded up to a power of two
+    void reserve(size_t capacity) {
+        _mask = std::bit_ceil(capacity) - 1;
+        _spans = std::make_unique<Span[]>(_mask + 1);
+    }
+
+    void record(const Span& span) {
+        const uint64_t written = _written.load(std::memory_order_relaxed);
+        _spans[written & _mask] = span;
+        _written.store(written + 1, std::memory_order_release);
+    }
+
+    // one "X" (complete) event per kept span, each preceded by a comma unless it's the first
+    void write_json(std::ostream& out, size_t tid, bool& first) const {
+        static constexpr const char* PRIORITY_NAMES[] = { "high", "normal", "background" };
+
+        const uint64_t written = _written.load(std::memory_order_acquire);
+        const uint64_t kept = std::min<uint64_t>(written, _mask + 1);
+        for (uint64_t i = written - kept; i < written; ++i) {
+            const Span& span = _spans[i & _mask];
+            out << (first ? "\n" : ",\n") << R"({"name":")" << (span.helping ? "task (helping)" : "task")
+                << R"(","cat":")" << PRIORITY_NAMES[span.priority] << R"(","ph":"X","pid":1,"tid":)" << tid
+                << R"(,"ts":)";
+            write_microseconds(out, span.begin_ns);
+            out << R"(,"dur":)";
+            write_microseconds(out, span.end_ns - span.begin_ns);
+            out << '}';
+            first = false;
+        }
+    }
+
+    // spans ever recorded, including the ones already overwritten
+    [[nodiscard]] auto written() const -> uint64_t { return _written.load(std::memory_order_acquire); }
+
+private:
+    // trace-event timestamps are in microseconds, keep the nanoseconds as three decimals.
+    // written from the integer, a double at the stream's default precision loses them
+    static void write_microseconds(std::ostream& out, int64_t ns) {
+        const uint64_t magnitude = ns < 0 ? 0 - static_cast<uint64_t>(ns) : static_cast<uint64_t>(ns);
+        const uint64_t fraction = magnitude % 1000;
+        out << (ns < 0 ? "-" : "") << magnitude / 1000 << '.' << static_cast<char>('0' + fraction / 100)
+            << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+    }
+
+    std::unique_ptr<Span[]> _spans;
+    uint64_t _mask = 0;
+    std::atomic<uint64_t> _written{ 0 };
+};